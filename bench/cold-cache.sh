@@ -0,0 +1,70 @@
+#!/usr/bin/env bash
+# Compares reading the input WARCs on demand with the read-ahead block reader
+# (--read-ahead), with the input dropped from the page cache before every run.
+#
+# Usage: cold-cache.sh [-n runs] [-a read_ahead] [-s read_size_mb] *.warc.gz
+# Extra warc2text options can be given in $WARC2TEXT_OPTIONS, and the binary in
+# $WARC2TEXT. Prints the wall time of each run in seconds.
+#
+# Dropping the whole page cache needs root. Without it, the cached pages of the
+# input files are dropped one file at a time with dd iflag=nocache, which is
+# enough unless the files are also cached by a network filesystem client.
+#
+set -euo pipefail
+
+RUNS=3
+AHEAD=8
+READ_SIZE=1
+
+while getopts "n:a:s:" opt; do
+	case $opt in
+		n) RUNS=$OPTARG ;;
+		a) AHEAD=$OPTARG ;;
+		s) READ_SIZE=$OPTARG ;;
+		*) exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -eq 0 ]; then
+	echo "Usage: $0 [-n runs] [-a read_ahead] [-s read_size_mb] *.warc.gz" >&2
+	exit 1
+fi
+
+OUTPUT=$(mktemp -d ./coldXXXX)
+trap 'rm -rf $OUTPUT' EXIT
+
+drop_cache() {
+	sync
+	if [ -w /proc/sys/vm/drop_caches ]; then
+		echo 3 > /proc/sys/vm/drop_caches
+	else
+		for FILE in "$@"; do
+			dd if="$FILE" iflag=nocache count=0 status=none
+		done
+	fi
+}
+
+run() {
+	local ahead=$1
+	shift
+	drop_cache "$@"
+	rm -rf $OUTPUT/out
+	local start=$(date +%s%N)
+	${WARC2TEXT:-warc2text} \
+		-o $OUTPUT/out \
+		--read-size $READ_SIZE \
+		--read-ahead $ahead \
+		${WARC2TEXT_OPTIONS:-} \
+		"$@" \
+		2> $OUTPUT/log.txt
+	local end=$(date +%s%N)
+	local ms=$(( (end - start) / 1000000 ))
+	printf "%d.%03d\n" $((ms / 1000)) $((ms % 1000))
+}
+
+printf "%-16s %s\n" "--read-ahead" "seconds"
+for i in $(seq $RUNS); do
+	printf "%-16s %s\n" 0 $(run 0 "$@")
+	printf "%-16s %s\n" $AHEAD $(run $AHEAD "$@")
+done
@@ -24,6 +24,8 @@ namespace warc2text {
       compressor_stream() {
           compression = Compression::gzip;
           level = 3;
+          buf_size = 32*1024;
+          written = false;
     }
 
     CompressWriter::CompressWriter(Compression c, int l)
@@ -32,36 +34,72 @@ namespace warc2text {
       compressor_stream() {
           compression = c;
           level = l;
+          buf_size = 32*1024;
+          written = false;
     }
 
     CompressWriter::~CompressWriter() {
         if (file.is_open()){
-            compressor.reset();
+            compressor->reset();
         }
     }
 
-    void CompressWriter::open(const std::string &filename, unsigned buf_size) {
-        file = std::ofstream(filename, std::ios_base::out | std::ios_base::binary);
+    void CompressWriter::open(const std::string &filename, unsigned buf_size, bool append) {
+        this->filename = filename;
+        this->buf_size = buf_size;
+        if (append)
+            file = std::ofstream(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::app | std::ios_base::ate);
+        else
+            file = std::ofstream(filename, std::ios_base::out | std::ios_base::binary);
+        start();
+    }
+
+    void CompressWriter::start() {
+        compressor = std::make_unique<bio::filtering_streambuf<bio::output>>();
         switch(compression) {
             case Compression::gzip:
-                compressor.push(bio::gzip_compressor(bio::gzip_params(level)));
+                compressor->push(bio::gzip_compressor(bio::gzip_params(level)));
                 break;
             case Compression::zstd:
-                compressor.push(bio::zstd_compressor(bio::zstd_params(level)));
+                compressor->push(bio::zstd_compressor(bio::zstd_params(level)));
                 break;
         }
-        compressor.push(file, buf_size);
-        compressor_stream = std::unique_ptr<std::ostream>(new std::ostream(&compressor));
+        compressor->push(file, buf_size);
+        compressor_stream = std::unique_ptr<std::ostream>(new std::ostream(compressor.get()));
+        written = false;
     }
 
     void CompressWriter::writeLine(const std::string &text) {
         *compressor_stream << text << "\n";
+        written = true;
     }
 
     bool CompressWriter::is_open() {
         return file.is_open();
     }
 
+    std::size_t CompressWriter::checkpoint() {
+        if (written) {
+            // closing the chain writes the end of the member, following lines go in a new one
+            compressor_stream.reset();
+            compressor->reset();
+            start();
+        }
+        file.flush();
+        return file.tellp();
+    }
+
+    const std::string& CompressWriter::getFilename() const {
+        return filename;
+    }
+
+    // whether the strings toJSON() puts in the metadata of record are valid UTF-8
+    bool validMetadata(Record const &record) {
+        return util::isValidUTF8(record.getFilename()) && util::isValidUTF8(record.getURL())
+            && util::isValidUTF8(record.getHTTPcontentType()) && util::isValidUTF8(record.getWARCdate())
+            && util::isValidUTF8(record.getCharset());
+    }
+
     json toJSON(Record const &record, std::string const &chunk, bool metadata_only) {
         json obj = {
              {"f", record.getFilename()},
@@ -83,15 +121,16 @@ namespace warc2text {
         return obj;
     }
 
-    std::string toJSON(const std::string &text, const std::string &field_name,
+    std::string toJSON(std::string_view text, const std::string &field_name,
             json::error_handler_t encoding_error) {
-        json object = { {field_name, text} };
+        json object = { {field_name, std::string(text)} };
         std::string s;
         return object.dump(-1, ' ', false, encoding_error);
     }
 
     LangWriter::LangWriter(const std::string& path, const std::unordered_set<std::string>& output_files,
-                           Compression c, int l, Format f, json::error_handler_t e, unsigned buf_size)
+                           Compression c, int l, Format f, json::error_handler_t e, unsigned buf_size,
+                           const std::unordered_set<std::string>& append_files)
     : metadata_file(c,l), url_file(c,l), mime_file(c,l), text_file(c,l), html_file(c,l), file_file(c,l), date_file(c,l), format(f), encoding_error(e)
     {
         util::createDirectories(path);
@@ -103,25 +142,33 @@ namespace warc2text {
         }
 
         if (output_files.count("metadata"))
-            metadata_file.open(path + "/metadata" + suffix, buf_size);
+            metadata_file.open(path + "/metadata" + suffix, buf_size, append_files.count(path + "/metadata" + suffix));
         if (output_files.count("url"))
-            url_file.open(path + "/url" + suffix, buf_size);
+            url_file.open(path + "/url" + suffix, buf_size, append_files.count(path + "/url" + suffix));
         if (output_files.count("text"))
-            text_file.open(path + "/text" + suffix, buf_size);
+            text_file.open(path + "/text" + suffix, buf_size, append_files.count(path + "/text" + suffix));
         if (output_files.count("mime"))
-            mime_file.open(path + "/mime" + suffix, buf_size);
+            mime_file.open(path + "/mime" + suffix, buf_size, append_files.count(path + "/mime" + suffix));
         if (output_files.count("html"))
-            html_file.open(path + "/html" + suffix, buf_size);
+            html_file.open(path + "/html" + suffix, buf_size, append_files.count(path + "/html" + suffix));
         if (output_files.count("file"))
-            file_file.open(path + "/file" + suffix, buf_size);
+            file_file.open(path + "/file" + suffix, buf_size, append_files.count(path + "/file" + suffix));
         if (output_files.count("date"))
-            date_file.open(path + "/date" + suffix, buf_size);
+            date_file.open(path + "/date" + suffix, buf_size, append_files.count(path + "/date" + suffix));
     }
 
-    void LangWriter::write(Record const &record, std::string const &chunk) {
-        // Serialize html and text content
-        // to trigger any possible exception (e.g. utf8 encoding error)
-        // before starting to write so any possible offsets are avoided
+    bool LangWriter::write(Record const &record, std::string const &chunk) {
+        // json refuses invalid UTF-8 when encoding errors are strict, check everything that goes
+        // into json before starting to write so that the files do not get out of step
+        if (encoding_error == json_error::strict) {
+            if (format == Format::json && html_file.is_open() && !util::isValidUTF8(record.getPayload()))
+                return false;
+            if (format == Format::json && text_file.is_open() && !util::isValidUTF8(chunk))
+                return false;
+            if (metadata_file.is_open() && !validMetadata(record))
+                return false;
+        }
+
         std::string html_content, text_content;
         if (html_file.is_open()) {
             if (format == Format::json)
@@ -151,6 +198,13 @@ namespace warc2text {
             html_file.writeLine(html_content);
         if (text_file.is_open())
             text_file.writeLine(text_content);
+        return true;
+    }
+
+    void LangWriter::checkpoint(std::map<std::string, std::size_t>& sizes) {
+        for (CompressWriter* file : {&metadata_file, &url_file, &mime_file, &text_file, &html_file, &file_file, &date_file})
+            if (file->is_open())
+                sizes[file->getFilename()] = file->checkpoint();
     }
 
     std::string get_paragraph_id(const std::string& text) {
@@ -168,29 +222,48 @@ namespace warc2text {
         return result;
     }
 
-    void BilangWriter::write(const Record& record, [[maybe_unused]] bool skipped_extraction, bool paragraph_identification) {
+    bool BilangWriter::write(const Record& record, [[maybe_unused]] bool skipped_extraction, bool paragraph_identification) {
         for (const auto& it : record.getTextByLangs()) {
             std::string chunk = it.second;
 
             if (paragraph_identification)
                 chunk = get_paragraph_id(chunk);
 
-            auto writer_it = writers.try_emplace(it.first, folder + "/" + it.first, output_files, compression, level, format, encoding_error, buf_size);
-            writer_it.first->second.write(record, chunk);
+            auto writer_it = writers.try_emplace(it.first, folder + "/" + it.first, output_files, compression, level, format, encoding_error, buf_size, append_files);
+            if (!writer_it.first->second.write(record, chunk))
+                return false;
         }
+        return true;
+    }
+
+    void BilangWriter::checkpoint(std::map<std::string, std::size_t>& sizes) {
+        for (auto& writer : writers)
+            writer.second.checkpoint(sizes);
+    }
+
+    void BilangWriter::resume(const std::map<std::string, std::size_t>& sizes) {
+        for (const auto& output : sizes)
+            append_files.insert(output.first);
     }
 
-    void JSONLinesWriter::write(const Record& record, bool skipped_extraction, [[maybe_unused]] bool paragraph_identification) {
+    bool JSONLinesWriter::write(const Record& record, bool skipped_extraction, [[maybe_unused]] bool paragraph_identification) {
         // JSON lines format (https://jsonlines.org)
+        bool strict = encoding_error == json_error::strict;
+        if (strict && !validMetadata(record))
+            return false;
         if(skipped_extraction) {
+            if (strict && !util::isValidUTF8(record.getPayload()))
+                return false;
             auto obj = toJSON(record, "", true);
-            obj["h"] = record.getPayload();
+            obj["h"] = std::string(record.getPayload());
             out_ << obj.dump(-1, ' ', false, encoding_error) << "\n";
-            return;
+            return true;
         }
         for (auto &&it : record.getTextByLangs()) {
             std::string chunk = it.second;
             std::string lang = it.first;
+            if (strict && (!util::isValidUTF8(chunk) || !util::isValidUTF8(lang)))
+                return false;
 
             auto obj = toJSON(record, chunk, false);
 
@@ -200,6 +273,7 @@ namespace warc2text {
 
             out_ << obj.dump(-1, ' ', false, encoding_error) << "\n";
         }
+        return true;
     }
 
     std::istream& operator>>(std::istream& in, Compression &c) {
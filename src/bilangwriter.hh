@@ -1,6 +1,7 @@
 #ifndef WARC2TEXT_WRITER_HH
 #define WARC2TEXT_WRITER_HH
 
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
 #include <sstream>
@@ -25,7 +26,14 @@ namespace warc2text {
      */
     class RecordWriter {
     public:
-        virtual void write(const Record& record, bool skipped_extraction, bool paragraph_identification = false) = 0;
+        // false if the record, or what was left of it, could not be written because it is not valid
+        // UTF-8 and encoding errors are strict
+        virtual bool write(const Record& record, bool skipped_extraction, bool paragraph_identification = false) = 0;
+        // flush everything written so far to a point the output files can be cut back to,
+        // and put the size of each of them in sizes
+        virtual void checkpoint([[maybe_unused]] std::map<std::string, std::size_t>& sizes) {}
+        // append to the output files in sizes, left by a run that stopped, instead of starting them over
+        virtual void resume([[maybe_unused]] const std::map<std::string, std::size_t>& sizes) {}
         virtual ~RecordWriter() = default;
     };
 
@@ -36,19 +44,29 @@ namespace warc2text {
     class CompressWriter {
         private:
             std::ofstream file;
-            bio::filtering_streambuf<bio::output> compressor;
+            std::string filename;
+            std::unique_ptr<bio::filtering_streambuf<bio::output>> compressor; // a new one for every member
             Compression compression;
             std::unique_ptr<std::ostream> compressor_stream;
             int level;
+            unsigned buf_size;
+            bool written; // anything written since the compressed member started
+
+            void start();
 
         public:
             CompressWriter();
             CompressWriter(Compression c, int l);
             ~CompressWriter();
-            void open(const std::string& filename, unsigned buf_size = 32*1024);
+            // with append, add to what is in the file already instead of truncating it. What is written
+            // starts a new compressed stream, which decompresses as a continuation of the ones before.
+            void open(const std::string& filename, unsigned buf_size = 32*1024, bool append = false);
             void close();
             void writeLine(const std::string& text);
             bool is_open();
+            // end the compressed member, so the file can be cut back to here, and return its size
+            std::size_t checkpoint();
+            const std::string& getFilename() const;
     };
 
     /**
@@ -70,8 +88,11 @@ namespace warc2text {
         public:
             LangWriter(const std::string& folder, const std::unordered_set<std::string>& output_files,
                        Compression c = Compression::gzip, int l = 3, Format f = Format::b64,
-                       json_error e = json_error::replace, unsigned buf_size = 32*1024);
-            void write(const Record& record, const std::string &chunk);
+                       json_error e = json_error::replace, unsigned buf_size = 32*1024,
+                       const std::unordered_set<std::string>& append_files = {});
+            // false if nothing was written, because of invalid UTF-8 with strict encoding errors
+            bool write(const Record& record, const std::string &chunk);
+            void checkpoint(std::map<std::string, std::size_t>& sizes);
     };
 
     class BilangWriter : public RecordWriter {
@@ -84,6 +105,7 @@ namespace warc2text {
             Format format;
             json_error encoding_error;
             unsigned buf_size;
+            std::unordered_set<std::string> append_files; // left by a previous run
         public:
             BilangWriter(const std::string& folder, const std::unordered_set<std::string>& output_files = {},
                          Compression c = Compression::gzip, int l = 3, Format f = Format::b64,
@@ -93,7 +115,9 @@ namespace warc2text {
                 //
             };
 
-            virtual void write(const Record& record, bool skipped_extraction, bool paragraph_identification = false);
+            virtual bool write(const Record& record, bool skipped_extraction, bool paragraph_identification = false);
+            void checkpoint(std::map<std::string, std::size_t>& sizes) override;
+            void resume(const std::map<std::string, std::size_t>& sizes) override;
     };
 
     class JSONLinesWriter : public RecordWriter {
@@ -103,7 +127,7 @@ namespace warc2text {
         public:
             explicit JSONLinesWriter(std::ostream &out, json_error e) : out_(out), encoding_error(e) {};
 
-            virtual void write(const Record& record, bool skipped_extraction, bool paragraph_identification = false);
+            virtual bool write(const Record& record, bool skipped_extraction, bool paragraph_identification = false);
     };
 }
 
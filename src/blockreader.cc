@@ -0,0 +1,126 @@
+#include "blockreader.hh"
+#include "warcreader.hh"
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace warc2text {
+    AsyncBlockReader::AsyncBlockReader(int fd, const std::string& filename, std::size_t block_size, unsigned depth) :
+        fd(fd),
+        filename(filename),
+        block_size(std::max<std::size_t>(block_size, 1)),
+        seekable(false),
+        base_offset(0),
+        slots(std::max(depth, 1u)),
+        next_issue(0),
+        next_consume(0),
+        holding(false),
+        eof_block(std::numeric_limits<std::size_t>::max()),
+        stop(false)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            off_t offset = lseek(fd, 0, SEEK_CUR);
+            seekable = offset >= 0;
+            base_offset = seekable ? offset : 0;
+        }
+        if (seekable)
+            posix_fadvise(fd, base_offset, 0, POSIX_FADV_SEQUENTIAL);
+
+        for (Slot& slot : slots)
+            slot.data.resize(this->block_size);
+
+        // unseekable input has to be read in order, so only one thread can read it
+        unsigned n_threads = seekable ? slots.size() : 1;
+        for (unsigned i = 0; i < n_threads; ++i)
+            threads.emplace_back(&AsyncBlockReader::run, this);
+    }
+
+    AsyncBlockReader::~AsyncBlockReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        changed.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    void AsyncBlockReader::run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            // a slot can only be reused once the consumer is done with the block in it
+            changed.wait(lock, [this]{
+                std::size_t released = next_consume - (holding ? 1 : 0);
+                return stop || (next_issue <= eof_block && next_issue < released + slots.size());
+            });
+            if (stop)
+                return;
+
+            std::size_t index = next_issue++;
+            Slot& slot = slots[index % slots.size()];
+            lock.unlock();
+
+            int error = 0;
+            std::size_t len = readBlock(index, slot.data.data(), error);
+
+            lock.lock();
+            slot.len = len;
+            slot.error = error;
+            slot.ready = true;
+            if (error == 0 && len < block_size && index < eof_block)
+                eof_block = index;
+            changed.notify_all();
+        }
+    }
+
+    std::size_t AsyncBlockReader::readBlock(std::size_t index, uint8_t* data, int& error) {
+        std::size_t done = 0;
+        while (done < block_size) {
+            ssize_t n;
+            if (seekable)
+                n = ::pread(fd, data + done, block_size - done, base_offset + index * block_size + done);
+            else
+                n = ::read(fd, data + done, block_size - done);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                error = errno;
+                break;
+            }
+            if (n == 0)
+                break;
+            done += n;
+        }
+        return done;
+    }
+
+    std::size_t AsyncBlockReader::next(const uint8_t*& data) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (holding) {
+            slots[(next_consume - 1) % slots.size()].ready = false;
+            holding = false;
+            changed.notify_all();
+        }
+
+        Slot& slot = slots[next_consume % slots.size()];
+        changed.wait(lock, [&]{ return slot.ready || next_consume > eof_block; });
+        if (!slot.ready)
+            return 0;
+
+        if (slot.error != 0) {
+            BOOST_LOG_TRIVIAL(error) << "WARC " << filename << ": error during reading: " << std::strerror(slot.error);
+            throw WARCFileException();
+        }
+
+        data = slot.data.data();
+        ++next_consume;
+        holding = true;
+        return slot.len;
+    }
+}
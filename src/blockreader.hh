@@ -0,0 +1,57 @@
+#ifndef WARC2TEXT_BLOCKREADER_HH
+#define WARC2TEXT_BLOCKREADER_HH
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+namespace warc2text {
+    /**
+     * Reads a file as a sequence of fixed size blocks, keeping up to `depth` reads in flight
+     * on background threads ahead of the consumer. Regular files are read with pread from
+     * `depth` threads at once, which hides the per request latency of network filesystems.
+     * Pipes and other unseekable inputs fall back to a single thread reading sequentially.
+     */
+    class AsyncBlockReader {
+        public:
+            AsyncBlockReader(int fd, const std::string& filename, std::size_t block_size, unsigned depth);
+            ~AsyncBlockReader();
+
+            // point data to the next block of the file and return its size, 0 at the end of the file.
+            // The block stays valid until the next call.
+            std::size_t next(const uint8_t*& data);
+
+        private:
+            struct Slot {
+                std::vector<uint8_t> data;
+                std::size_t len = 0;
+                int error = 0;
+                bool ready = false;
+            };
+
+            int fd;
+            std::string filename;
+            std::size_t block_size;
+            bool seekable;
+            off_t base_offset;
+
+            std::vector<Slot> slots;
+            std::size_t next_issue; // next block to be read
+            std::size_t next_consume; // next block to be handed out
+            bool holding; // the consumer still uses block next_consume - 1
+            std::size_t eof_block; // first block that came back short
+            bool stop;
+            std::mutex mutex;
+            std::condition_variable changed;
+            std::vector<std::thread> threads;
+
+            void run();
+            std::size_t readBlock(std::size_t index, uint8_t* data, int& error);
+    };
+}
+
+#endif
@@ -0,0 +1,265 @@
+#include "cdx.hh"
+#include "util.hh"
+#include <boost/log/trivial.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/join.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+namespace {
+    using json = nlohmann::json;
+    using ordered_json = nlohmann::ordered_json;
+
+    // 14 digit CDX timestamp of a WARC-Date
+    std::string timestamp(const std::string& date) {
+        std::string digits;
+        for (char c : date)
+            if (c >= '0' && c <= '9' && digits.size() < 14)
+                digits.push_back(c);
+        digits.resize(14, '0');
+        return digits;
+    }
+
+    bool parseNumber(const std::string& value, std::size_t& number) {
+        auto result = std::from_chars(value.data(), value.data() + value.size(), number);
+        return result.ec == std::errc() && result.ptr == value.data() + value.size();
+    }
+
+    // pywb and others write numbers in CDXJ as strings
+    bool jsonNumber(const json& object, const char* key, std::size_t& number) {
+        auto it = object.find(key);
+        if (it == object.end())
+            return false;
+        if (it->is_number_unsigned()) {
+            number = it->get<std::size_t>();
+            return true;
+        }
+        return it->is_string() && parseNumber(it->get<std::string>(), number);
+    }
+
+    // positions of the fields used in a CDX line, from the legend in its header
+    struct CDXFields {
+        int filename = 10;
+        int offset = 9;
+        int length = 8;
+
+        // "CDX N b a m s k r M S V g" is the default
+        void readLegend(const std::string& line) {
+            std::istringstream legend(line);
+            std::string token;
+            legend >> token; // CDX
+            filename = offset = length = -1;
+            for (int i = 0; legend >> token; ++i) {
+                if (token == "g")
+                    filename = i;
+                else if (token == "V" || token == "v")
+                    offset = i;
+                else if (token == "S")
+                    length = i;
+            }
+        }
+    };
+}
+
+namespace warc2text {
+    void readCDX(const std::string& filename, const std::string& prefix, WARCIndex& index) {
+        std::ifstream file;
+        if (filename != "-") {
+            file.open(filename);
+            if (!file)
+                throw CDXFileException();
+        }
+        std::istream& f = filename == "-" ? std::cin : file;
+
+        CDXFields fields;
+        std::string line;
+        std::size_t entries = 0;
+        for (std::size_t line_i = 1; std::getline(f, line); ++line_i) {
+            std::size_t start = line.find_first_not_of(' ');
+            if (start == std::string::npos || line[start] == '#')
+                continue;
+            if (boost::algorithm::starts_with(line.substr(start), "CDX ")) {
+                fields.readLegend(line.substr(start));
+                continue;
+            }
+
+            std::string warc;
+            IndexEntry entry{0, 0};
+            bool valid = false;
+            std::size_t brace = line.find('{');
+            if (brace != std::string::npos) {
+                // CDXJ: SURT, timestamp and a JSON object
+                json object = json::parse(line.begin() + brace, line.end(), nullptr, false);
+                if (object.is_object() && object.contains("filename") && object["filename"].is_string()) {
+                    warc = object["filename"].get<std::string>();
+                    valid = jsonNumber(object, "offset", entry.offset);
+                    jsonNumber(object, "length", entry.length);
+                }
+            } else {
+                std::istringstream tokens(line);
+                std::vector<std::string> values{std::istream_iterator<std::string>(tokens), std::istream_iterator<std::string>()};
+                auto field = [&values](int i) { return i >= 0 && std::size_t(i) < values.size() ? values[i] : std::string(); };
+                warc = field(fields.filename);
+                valid = !warc.empty() && warc != "-" && parseNumber(field(fields.offset), entry.offset);
+                if (!parseNumber(field(fields.length), entry.length))
+                    entry.length = 0;
+            }
+
+            if (!valid || warc.empty()) {
+                BOOST_LOG_TRIVIAL(warning) << "Could not parse CDX line at " << filename << ":" << line_i;
+                continue;
+            }
+            index[prefix + warc].push_back(entry);
+            ++entries;
+        }
+
+        for (auto& records : index) {
+            std::vector<IndexEntry>& list = records.second;
+            std::sort(list.begin(), list.end(), [](const IndexEntry& a, const IndexEntry& b) { return a.offset < b.offset; });
+            list.erase(std::unique(list.begin(), list.end(), [](const IndexEntry& a, const IndexEntry& b) { return a.offset == b.offset; }), list.end());
+        }
+        BOOST_LOG_TRIVIAL(info) << "CDX " << filename << ": " << entries << " records in " << index.size() << " WARCs";
+    }
+
+    std::string surt(const std::string& url) {
+        std::string rest = url.substr(0, url.find('#'));
+        std::size_t scheme = rest.find("://");
+        if (scheme != std::string::npos)
+            rest.erase(0, scheme + 3);
+        util::toLower(rest);
+
+        std::size_t path_start = std::min(rest.find('/'), rest.find('?'));
+        std::string host = rest.substr(0, path_start);
+        std::string path = path_start == std::string::npos ? "/" : rest.substr(path_start);
+        if (path[0] == '?')
+            path.insert(0, "/");
+
+        // no user info, default ports, www or trailing dot
+        std::size_t at = host.rfind('@');
+        if (at != std::string::npos)
+            host.erase(0, at + 1);
+        if (boost::algorithm::ends_with(host, ":80") || boost::algorithm::ends_with(host, ":443"))
+            host.erase(host.rfind(':'));
+        if (boost::algorithm::starts_with(host, "www."))
+            host.erase(0, 4);
+        while (!host.empty() && host.back() == '.')
+            host.pop_back();
+
+        // IP addresses stay as they are, host names are reversed and keep any other port at the end
+        std::string reversed;
+        if (host.find_first_not_of("0123456789.:") == std::string::npos) {
+            reversed = host;
+        } else {
+            std::size_t colon = host.find(':');
+            std::string port = colon == std::string::npos ? std::string() : host.substr(colon);
+            std::vector<std::string> labels = util::split(host.substr(0, colon), ".");
+            for (auto label = labels.rbegin(); label != labels.rend(); ++label) {
+                if (!reversed.empty())
+                    reversed.push_back(',');
+                reversed += *label;
+            }
+            reversed += port;
+        }
+
+        // and query arguments in order
+        std::size_t query_start = path.find('?');
+        if (query_start != std::string::npos) {
+            std::vector<std::string> arguments = util::split(path.substr(query_start + 1), "&");
+            std::sort(arguments.begin(), arguments.end());
+            path.erase(query_start + 1);
+            for (std::size_t i = 0; i < arguments.size(); ++i)
+                path += (i > 0 ? "&" : "") + arguments[i];
+        }
+        return reversed + ")" + path;
+    }
+
+    CDXJWriter::CDXJWriter() {
+        cdxj = nullptr;
+        sorted = false;
+    }
+
+    CDXJWriter::~CDXJWriter() {
+        close();
+    }
+
+    void CDXJWriter::open(const std::string& cdxj_filename, bool sort_lines, bool append) {
+        filename = cdxj_filename;
+        sorted = sort_lines;
+        auto filename_offset = filename.find_last_of('/');
+        if (filename_offset != std::string::npos)
+            util::createDirectories(filename.substr(0, filename_offset));
+        cdxj = std::fopen(filename.c_str(), append ? "ab" : "wb");
+        if (!cdxj)
+            BOOST_LOG_TRIVIAL(error) << "CDXJ " << filename << ": file opening failed";
+    }
+
+    void CDXJWriter::checkpoint(std::map<std::string, std::size_t>& sizes) {
+        // sorted lines are only written at the end
+        if (!cdxj || sorted)
+            return;
+        std::fflush(cdxj);
+        sizes[filename] = std::ftell(cdxj);
+    }
+
+    bool CDXJWriter::is_open() const {
+        return cdxj != nullptr;
+    }
+
+    void CDXJWriter::close() {
+        if (!cdxj)
+            return;
+        if (sorted) {
+            std::sort(lines.begin(), lines.end());
+            for (const std::string& line : lines)
+                std::fwrite(line.data(), 1, line.size(), cdxj);
+            lines.clear();
+        }
+        std::fclose(cdxj);
+        cdxj = nullptr;
+    }
+
+    void CDXJWriter::write(const Record& record) {
+        // like other indexers, leave out warcinfo and request records
+        if (!cdxj || record.getURL().empty() || record.getRecordType() == "request" || record.getRecordType() == "warcinfo")
+            return;
+
+        ordered_json fields;
+        fields["url"] = record.getURL();
+        if (record.getRecordType() == "revisit")
+            fields["mime"] = "warc/revisit";
+        else if (!record.getHTTPcontentType().empty())
+            fields["mime"] = record.getHTTPcontentType();
+        else
+            fields["mime"] = record.getWARCcontentType().substr(0, record.getWARCcontentType().find(';'));
+        if (record.HTTPheaderExists("status"))
+            fields["status"] = std::string(record.getHTTPheaderProperty("status").substr(0, record.getHTTPheaderProperty("status").find(' ')));
+        if (record.headerExists("warc-payload-digest"))
+            fields["digest"] = std::string(record.getHeaderProperty("warc-payload-digest"));
+        fields["length"] = std::to_string(record.getSize());
+        fields["offset"] = std::to_string(record.getOffset());
+        fields["filename"] = record.getFilename();
+        if (!record.getCharset().empty())
+            fields["charset"] = record.getCharset();
+
+        std::vector<std::string> languages;
+        for (const auto& chunk : record.getTextByLangs())
+            if (chunk.first != LanguageDetector::kUnknownLanguageLabel)
+                languages.push_back(chunk.first);
+        if (!languages.empty()) {
+            std::sort(languages.begin(), languages.end());
+            fields["languages"] = boost::algorithm::join(languages, ",");
+        }
+
+        std::string line = surt(record.getURL()) + " " + timestamp(record.getWARCdate()) + " "
+            + fields.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+        if (sorted)
+            lines.push_back(std::move(line));
+        else
+            std::fwrite(line.data(), 1, line.size(), cdxj);
+    }
+}
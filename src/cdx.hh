@@ -0,0 +1,57 @@
+#ifndef WARC2TEXT_CDX_HH
+#define WARC2TEXT_CDX_HH
+
+#include "record.hh"
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace warc2text {
+    // where a record is stored in its WARC, length is 0 if the index does not say
+    struct IndexEntry {
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    // WARC file name -> the records of it listed in the index, sorted by offset
+    typedef std::map<std::string, std::vector<IndexEntry>> WARCIndex;
+
+    class CDXFileException : public std::exception {
+        virtual const char* what() const throw() { return "CDX index could not be opened"; }
+    };
+
+    // read a CDX or CDXJ index ("-" is stdin) into index, prefix is put in front of the file names
+    // in it. Lines that cannot be parsed are skipped with a warning.
+    void readCDX(const std::string& filename, const std::string& prefix, WARCIndex& index);
+
+    // Sort-friendly URI Reordering Transform of url: "http://www.Example.com/a?b=1&a=2" becomes "com,example)/a?a=2&b=1"
+    std::string surt(const std::string& url);
+
+    /**
+     * Writes a CDXJ line for every record it is given, as they come or, when sorted,
+     * all at once in SURT order when it is closed. Besides the usual fields, lines
+     * carry the charset and the languages detected in the record.
+     */
+    class CDXJWriter {
+        private:
+            std::FILE* cdxj;
+            std::string filename;
+            bool sorted;
+            std::vector<std::string> lines;
+        public:
+            CDXJWriter();
+            ~CDXJWriter();
+            // append carries on the index of a run that is resumed
+            void open(const std::string& cdxj_filename, bool sort_lines, bool append = false);
+            void close();
+            bool is_open() const;
+            void write(const Record& record);
+            // flush what was written so far and put the size of the file in sizes, unless sorting
+            void checkpoint(std::map<std::string, std::size_t>& sizes);
+    };
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include "checkpoint.hh"
+#include <boost/log/trivial.hpp>
+#include <nlohmann/json.hpp>
+#include <cstdio>
+#include <fstream>
+
+namespace warc2text {
+    using ordered_json = nlohmann::ordered_json;
+
+    bool CheckpointLedger::load(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file)
+            return false;
+        ordered_json ledger = ordered_json::parse(file, nullptr, false);
+        if (!ledger.is_object() || !ledger["inputs"].is_object() || !ledger["outputs"].is_object()) {
+            BOOST_LOG_TRIVIAL(error) << "Checkpoint " << filename << ": invalid ledger";
+            throw CheckpointFileException();
+        }
+        inputs.clear();
+        outputs.clear();
+        for (const auto& input : ledger["inputs"].items()) {
+            const ordered_json& progress = input.value();
+            if (!progress.is_object() || !progress.contains("offset") || !progress["offset"].is_number_unsigned()
+                    || !progress.contains("done") || !progress["done"].is_boolean()) {
+                BOOST_LOG_TRIVIAL(error) << "Checkpoint " << filename << ": invalid entry for " << input.key();
+                throw CheckpointFileException();
+            }
+            inputs[input.key()] = InputProgress{progress["offset"].get<std::size_t>(), progress["done"].get<bool>()};
+        }
+        for (const auto& output : ledger["outputs"].items()) {
+            if (!output.value().is_number_unsigned()) {
+                BOOST_LOG_TRIVIAL(error) << "Checkpoint " << filename << ": invalid entry for " << output.key();
+                throw CheckpointFileException();
+            }
+            outputs[output.key()] = output.value().get<std::size_t>();
+        }
+        return true;
+    }
+
+    void CheckpointLedger::save(const std::string& filename) const {
+        ordered_json ledger = {{"inputs", ordered_json::object()}, {"outputs", ordered_json::object()}};
+        for (const auto& input : inputs)
+            ledger["inputs"][input.first] = {{"offset", input.second.offset}, {"done", input.second.done}};
+        for (const auto& output : outputs)
+            ledger["outputs"][output.first] = output.second;
+
+        // write next to it and rename over it, renaming is atomic
+        std::string tmp_filename = filename + ".tmp";
+        {
+            std::ofstream file(tmp_filename, std::ios_base::out | std::ios_base::trunc);
+            file << ledger.dump(1) << "\n";
+            if (!file.flush()) {
+                BOOST_LOG_TRIVIAL(error) << "Checkpoint " << tmp_filename << ": could not write ledger";
+                throw CheckpointFileException();
+            }
+        }
+        if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+            BOOST_LOG_TRIVIAL(error) << "Checkpoint " << filename << ": could not replace ledger";
+            throw CheckpointFileException();
+        }
+    }
+
+    bool CheckpointLedger::isDone(const std::string& input) const {
+        auto progress = inputs.find(input);
+        return progress != inputs.end() && progress->second.done;
+    }
+
+    std::size_t CheckpointLedger::resumeOffset(const std::string& input) const {
+        auto progress = inputs.find(input);
+        return progress != inputs.end() ? progress->second.offset : 0;
+    }
+}
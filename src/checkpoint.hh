@@ -0,0 +1,42 @@
+#ifndef WARC2TEXT_CHECKPOINT_HH
+#define WARC2TEXT_CHECKPOINT_HH
+
+#include <cstddef>
+#include <exception>
+#include <map>
+#include <string>
+
+namespace warc2text {
+    class CheckpointFileException : public std::exception {
+        virtual const char* what() const throw() { return "Checkpoint ledger could not be read or written"; }
+    };
+
+    // how far the records of an input have been written out
+    struct InputProgress {
+        std::size_t offset{}; // offset of the first record that was not written yet
+        bool done{}; // all of its records were written
+    };
+
+    /**
+     * Ledger of how far a run got: for every input the offset up to which its records were
+     * written, and for every output file the size it had at that point. Output files are
+     * flushed at the end of a compressed member before the ledger is saved, so a run that
+     * stops for any reason can carry on by cutting its outputs back to these sizes and
+     * reading every input from its offset.
+     */
+    class CheckpointLedger {
+        public:
+            std::map<std::string, InputProgress> inputs;
+            std::map<std::string, std::size_t> outputs;
+
+            // returns false if there is no ledger at filename
+            bool load(const std::string& filename);
+            // replaces the ledger at filename in one go, so it is never left half written
+            void save(const std::string& filename) const;
+            bool isDone(const std::string& input) const;
+            // offset to start reading input at, 0 if the ledger does not know it
+            std::size_t resumeOffset(const std::string& input) const;
+    };
+}
+
+#endif
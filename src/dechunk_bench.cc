@@ -0,0 +1,63 @@
+// Times dechunk on chunked payloads with pathological chunk counts: the per chunk cost shows up
+// with many tiny chunks, and the cost of scanning size lines with huge chunk extensions.
+//
+// Usage: dechunk_bench [size_mb] [runs]
+// Prints the best time of each case in milliseconds and the input it dechunked per second.
+
+#include "decompress.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+    using namespace warc2text;
+
+    // chunked coding of about size bytes, made of the chunk repeated and a last empty chunk
+    std::string repeat(const std::string& chunk, std::size_t size) {
+        std::string input;
+        input.reserve(size + chunk.size() + 5);
+        while (input.size() < size)
+            input.append(chunk);
+        input.append("0\r\n\r\n");
+        return input;
+    }
+
+    std::string sizedChunk(std::size_t payload, const std::string& extension = "") {
+        char size[32];
+        std::snprintf(size, sizeof(size), "%zx", payload);
+        return size + extension + "\r\n" + std::string(payload, 'x') + "\r\n";
+    }
+
+    void run(const char* name, const std::string& input, int runs) {
+        double best = 0;
+        std::size_t out_size = 0;
+        DechunkStatus status = DechunkStatus::ok;
+        for (int i = 0; i < runs; ++i) {
+            // the copy is not timed, dechunk works in place
+            std::string work = input;
+            auto start = std::chrono::steady_clock::now();
+            status = dechunk(work);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (i == 0 || elapsed.count() < best)
+                best = elapsed.count();
+            out_size = work.size();
+        }
+        std::printf("%-28s %10zu -> %10zu bytes %9.2f ms %9.1f MB/s  %s\n", name, input.size(), out_size,
+                    best * 1e3, input.size() / best / 1e6, describe(status));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t size = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64) << 20;
+    int runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    run("8 KB chunks", repeat(sizedChunk(8192), size), runs);
+    run("1 byte chunks", repeat(sizedChunk(1), size), runs);
+    run("1 byte chunks, padded size", repeat("   0000000001  \r\nx\r\n", size), runs);
+    run("64 KB extension lines", repeat(sizedChunk(16, ";" + std::string(65536, 'e')), size), runs);
+    // a single size line that never ends is the worst case for finding the end of the line
+    run("unterminated extension", "1;" + std::string(size, 'e'), runs);
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include "decompress.hh"
+#include <zlib.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#ifdef WITH_BROTLI
+#include <brotli/decode.h>
+#endif
+
+namespace warc2text {
+    const std::unordered_set<std::string> noncompressed_content_encodings = {"none", "identity", "raw", "utf-8"};
+
+    namespace {
+        // size to start decoding into: what the gzip trailer says or a few times the payload, but
+        // never more than deflate could expand the payload to, nor than the limit
+        std::size_t initialSize(std::string_view payload, bool gzip, std::size_t limit) {
+            std::size_t size = payload.size() * 4;
+            if (gzip && payload.size() >= 18) {
+                const uint8_t* p = reinterpret_cast<const uint8_t*>(payload.data() + payload.size() - 4);
+                size = uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+            }
+            size = std::min(size, payload.size() * 1032);
+            return std::min(std::max<std::size_t>(size, 4096), limit);
+        }
+
+        DecodeStatus inflatePayload(std::string_view payload, int window_bits, bool gzip, std::string& decoded, std::size_t max_size) {
+            z_stream s{};
+            if (inflateInit2(&s, window_bits) != Z_OK)
+                return DecodeStatus::corrupt;
+
+            // one byte over max_size is enough to tell that it is too large
+            const std::size_t limit = max_size < std::numeric_limits<std::size_t>::max() ? max_size + 1 : max_size;
+            decoded.resize(initialSize(payload, gzip, limit));
+            std::size_t produced = 0;
+            s.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload.data()));
+            s.avail_in = std::min<std::size_t>(payload.size(), std::numeric_limits<uInt>::max());
+
+            DecodeStatus status = DecodeStatus::ok;
+            while (true) {
+                if (produced == decoded.size()) {
+                    if (decoded.size() >= limit) {
+                        status = DecodeStatus::too_large;
+                        break;
+                    }
+                    decoded.resize(std::min(decoded.size() * 2, limit));
+                }
+                s.next_out = reinterpret_cast<Bytef*>(&decoded[produced]);
+                s.avail_out = std::min<std::size_t>(decoded.size() - produced, std::numeric_limits<uInt>::max());
+                uInt avail_out = s.avail_out;
+                int ret = inflate(&s, Z_NO_FLUSH);
+                produced += avail_out - s.avail_out;
+
+                if (ret == Z_STREAM_END) {
+                    // gzip members can follow each other, anything else after the end is ignored
+                    if (gzip && s.avail_in >= 2 && s.next_in[0] == 0x1f && s.next_in[1] == 0x8b && inflateReset(&s) == Z_OK)
+                        continue;
+                    break;
+                }
+                // a payload cut short decodes to what there is of it
+                if (ret == Z_BUF_ERROR && s.avail_in == 0)
+                    break;
+                if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                    status = DecodeStatus::corrupt;
+                    break;
+                }
+            }
+            inflateEnd(&s);
+            if (produced > max_size)
+                status = DecodeStatus::too_large;
+            decoded.resize(produced);
+            return status;
+        }
+
+#ifdef WITH_BROTLI
+        DecodeStatus unbrotli(std::string_view payload, std::string& decoded, std::size_t max_size) {
+            BrotliDecoderState* state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+            if (!state)
+                return DecodeStatus::corrupt;
+
+            const std::size_t limit = max_size < std::numeric_limits<std::size_t>::max() ? max_size + 1 : max_size;
+            decoded.resize(initialSize(payload, false, limit));
+            std::size_t produced = 0;
+            const uint8_t* next_in = reinterpret_cast<const uint8_t*>(payload.data());
+            std::size_t available_in = payload.size();
+
+            DecodeStatus status = DecodeStatus::ok;
+            while (true) {
+                if (produced == decoded.size()) {
+                    if (decoded.size() >= limit) {
+                        status = DecodeStatus::too_large;
+                        break;
+                    }
+                    decoded.resize(std::min(decoded.size() * 2, limit));
+                }
+                uint8_t* next_out = reinterpret_cast<uint8_t*>(&decoded[produced]);
+                std::size_t available_out = decoded.size() - produced;
+                BrotliDecoderResult result = BrotliDecoderDecompressStream(state, &available_in, &next_in, &available_out, &next_out, nullptr);
+                produced = decoded.size() - available_out;
+
+                if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT)
+                    continue;
+                // done, or cut short and decoded to what there is of it
+                if (result == BROTLI_DECODER_RESULT_SUCCESS || result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT)
+                    break;
+                status = DecodeStatus::corrupt;
+                break;
+            }
+            BrotliDecoderDestroyInstance(state);
+            if (produced > max_size)
+                status = DecodeStatus::too_large;
+            decoded.resize(produced);
+            return status;
+        }
+#endif
+    }
+
+    DecodeStatus decodeContent(std::string_view payload, const std::string& encoding, std::string& decoded, std::size_t max_size) {
+        if (encoding == "gzip" || encoding == "x-gzip")
+            return inflatePayload(payload, 16 + MAX_WBITS, true, decoded, max_size);
+        if (encoding == "deflate") {
+            // zlib wrapped, as the specification says, or raw deflate, as plenty of servers send it
+            DecodeStatus status = inflatePayload(payload, MAX_WBITS, false, decoded, max_size);
+            if (status == DecodeStatus::corrupt)
+                status = inflatePayload(payload, -MAX_WBITS, false, decoded, max_size);
+            return status;
+        }
+#ifdef WITH_BROTLI
+        if (encoding == "br")
+            return unbrotli(payload, decoded, max_size);
+#endif
+        return DecodeStatus::unsupported;
+    }
+
+    const char* describe(DecodeStatus status) {
+        switch (status) {
+            case DecodeStatus::ok: return "ok";
+            case DecodeStatus::unsupported: return "unsupported HTTP Content-Encoding";
+            case DecodeStatus::corrupt: return "HTTP response decompression failed";
+            case DecodeStatus::too_large: return "HTTP response decompresses to more than the maximum record size";
+        }
+        return "unknown error";
+    }
+
+    const char* describe(DechunkStatus status) {
+        switch (status) {
+            case DechunkStatus::ok: return "ok";
+            case DechunkStatus::bad_chunk_size: return "chunk size line has unrecognized format";
+            case DechunkStatus::chunk_too_long: return "the specified chunk size is larger than the remaining part of the string";
+            case DechunkStatus::missing_crlf: return "cannot find CRLF immediately after a chunk";
+        }
+        return "unknown error";
+    }
+
+    DechunkStatus dechunk(std::string& input) {
+        const std::size_t length = input.size();
+        std::size_t read = 0, write = 0;
+        DechunkStatus status = DechunkStatus::ok;
+        while (read < length) {
+            std::size_t line_end = input.find("\r\n", read);
+            if (line_end == std::string::npos)
+                line_end = length;
+
+            std::size_t pos = read;
+            while (pos < line_end && std::isspace(static_cast<unsigned char>(input[pos])))
+                ++pos;
+            const std::size_t digits = pos;
+            std::size_t chunk_size = 0;
+            for (; pos < line_end; ++pos) {
+                char c = input[pos];
+                int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                if (digit < 0)
+                    break;
+                // past the length of the input it is too long anyway, stop before it overflows
+                if (chunk_size <= length)
+                    chunk_size = chunk_size * 16 + digit;
+            }
+            while (pos < line_end && (input[pos] == ' ' || input[pos] == '\t'))
+                ++pos;
+            if (pos == digits || (pos < line_end && input[pos] != ';')) {
+                status = DechunkStatus::bad_chunk_size;
+                break;
+            }
+
+            // drop the size line
+            read = std::min(line_end + 2, length);
+            if (chunk_size == 0)
+                break;
+
+            if (chunk_size >= length - read) {
+                status = DechunkStatus::chunk_too_long;
+                break;
+            }
+            if (write != read)
+                std::memmove(&input[write], &input[read], chunk_size);
+            write += chunk_size;
+            read += chunk_size;
+
+            if (input.compare(read, 2, "\r\n") != 0) {
+                status = DechunkStatus::missing_crlf;
+                break;
+            }
+            read += 2;
+        }
+        // move what is left after the chunks down, in one go
+        input.erase(write, read - write);
+        return status;
+    }
+}
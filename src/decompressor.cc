@@ -0,0 +1,95 @@
+#include "decompressor.hh"
+#include <boost/log/trivial.hpp>
+#include <zstd.h>
+#include <algorithm>
+#include <limits>
+#include <stdlib.h>
+
+namespace warc2text {
+    uint32_t readLE32(const void* data) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+    }
+
+    GzipDecompressor::GzipDecompressor() {
+        if (inflateInit2(&s, 32) != Z_OK) {
+            BOOST_LOG_TRIVIAL(error) << "Failed to init zlib";
+            abort();
+        }
+    }
+
+    GzipDecompressor::~GzipDecompressor() {
+        inflateEnd(&s);
+    }
+
+    StreamDecompressor::Status GzipDecompressor::decompress(const uint8_t*& in, std::size_t& in_len, uint8_t*& out, std::size_t& out_len) {
+        s.next_in = const_cast<Bytef*>(in);
+        s.avail_in = std::min<std::size_t>(in_len, std::numeric_limits<uInt>::max());
+        s.next_out = out;
+        s.avail_out = std::min<std::size_t>(out_len, std::numeric_limits<uInt>::max());
+        uInt avail_in = s.avail_in;
+        uInt avail_out = s.avail_out;
+        int ret = inflate(&s, Z_NO_FLUSH);
+        in += avail_in - s.avail_in;
+        in_len -= avail_in - s.avail_in;
+        out += avail_out - s.avail_out;
+        out_len -= avail_out - s.avail_out;
+        // Z_BUF_ERROR only means that no progress was possible
+        if (ret == Z_STREAM_END)
+            return Status::end;
+        return ret == Z_OK || ret == Z_BUF_ERROR ? Status::ok : Status::error;
+    }
+
+    void GzipDecompressor::reset() {
+        if (inflateReset(&s) != Z_OK) {
+            BOOST_LOG_TRIVIAL(error) << "Failed to reset zlib";
+            abort();
+        }
+    }
+
+    ZstdDecompressor::ZstdDecompressor() : ctx(ZSTD_createDCtx()) {
+        if (!ctx) {
+            BOOST_LOG_TRIVIAL(error) << "Failed to init zstd";
+            abort();
+        }
+    }
+
+    ZstdDecompressor::~ZstdDecompressor() {
+        ZSTD_freeDCtx(ctx);
+    }
+
+    StreamDecompressor::Status ZstdDecompressor::decompress(const uint8_t*& in, std::size_t& in_len, uint8_t*& out, std::size_t& out_len) {
+        ZSTD_inBuffer input{in, in_len, 0};
+        ZSTD_outBuffer output{out, out_len, 0};
+        std::size_t ret = ZSTD_decompressStream(ctx, &output, &input);
+        in += input.pos;
+        in_len -= input.pos;
+        out += output.pos;
+        out_len -= output.pos;
+        if (ZSTD_isError(ret))
+            return Status::error;
+        // 0 once the frame is complete and all of it has been written out
+        return ret == 0 ? Status::end : Status::ok;
+    }
+
+    void ZstdDecompressor::reset() {
+        // keeps the dictionary
+        ZSTD_DCtx_reset(ctx, ZSTD_reset_session_only);
+    }
+
+    bool ZstdDecompressor::loadDictionary(const std::string& dictionary) {
+        std::string raw;
+        const std::string* dict = &dictionary;
+        if (dictionary.size() >= 4 && readLE32(dictionary.data()) == ZSTD_MAGICNUMBER) {
+            unsigned long long size = ZSTD_getFrameContentSize(dictionary.data(), dictionary.size());
+            if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR)
+                return false;
+            raw.resize(size);
+            std::size_t ret = ZSTD_decompress(&raw[0], raw.size(), dictionary.data(), dictionary.size());
+            if (ZSTD_isError(ret) || ret != size)
+                return false;
+            dict = &raw;
+        }
+        return !ZSTD_isError(ZSTD_DCtx_loadDictionary(ctx, dict->data(), dict->size()));
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef WARC2TEXT_DECOMPRESSOR_HH
+#define WARC2TEXT_DECOMPRESSOR_HH
+
+#include "zlib.h"
+#include <cstdint>
+#include <string>
+
+struct ZSTD_DCtx_s;
+
+namespace warc2text {
+    // little endian 32 bit integer, as used by the gzip and zstd framing
+    uint32_t readLE32(const void* data);
+
+    /**
+     * Streaming decompressor for the compressed members a WARC is made of, each holding
+     * one record: gzip members or zstd frames. decompress() is fed input and output space
+     * until it reports the end of the member, then reset() gets it ready for the next one.
+     */
+    class StreamDecompressor {
+        public:
+            enum class Status { ok, end, error };
+            // decompress from in into out, advancing both pointers and decreasing both lengths
+            virtual Status decompress(const uint8_t*& in, std::size_t& in_len, uint8_t*& out, std::size_t& out_len) = 0;
+            virtual void reset() = 0;
+            virtual ~StreamDecompressor() = default;
+    };
+
+    class GzipDecompressor : public StreamDecompressor {
+        public:
+            GzipDecompressor();
+            Status decompress(const uint8_t*& in, std::size_t& in_len, uint8_t*& out, std::size_t& out_len) override;
+            void reset() override;
+            ~GzipDecompressor() override;
+        private:
+            z_stream s{};
+    };
+
+    class ZstdDecompressor : public StreamDecompressor {
+        public:
+            ZstdDecompressor();
+            Status decompress(const uint8_t*& in, std::size_t& in_len, uint8_t*& out, std::size_t& out_len) override;
+            void reset() override;
+            // use dictionary for all the following frames, it may be zstd compressed itself.
+            // Returns false if it cannot be used.
+            bool loadDictionary(const std::string& dictionary);
+            ~ZstdDecompressor() override;
+        private:
+            ZSTD_DCtx_s* ctx;
+    };
+}
+
+#endif
@@ -6,7 +6,7 @@
 
 #include <string>
 #include <algorithm>
-#include <stdexcept>
+#include <charconv>
 
 #define UNICODE_MAX 0x10FFFFul
 
@@ -51,8 +51,6 @@ namespace entities {
     void decodeEntities(const std::string& source, std::string& target) {
         std::size_t pos = source.find('&');
         std::size_t end_pos = 0;
-        std::size_t len;
-        auto* tail = new std::size_t;
         std::size_t entity_code;
         bool hex;
 
@@ -65,7 +63,7 @@ namespace entities {
             if (end_pos == std::string::npos) {
                 // entity has no proper ending, append the rest of the string and quit
                 target.append(source, pos);
-                break;
+                return;
             }
             else if (source[end_pos] != ';') {
                 // invalid char found: '&' didn't start a proper entity
@@ -73,17 +71,17 @@ namespace entities {
                 target.append(source, pos, end_pos-pos);
             } else if (source[pos+1] == '#') { // proper numeric entity
                 hex = ((pos+2 < end_pos) and (source[pos+2] == 'x' or source[pos+2] == 'X'));
-                len = end_pos - pos - (hex ? 3 : 2);
                 pos = pos + (hex ? 3 : 2);
-                try{
-                    entity_code = std::stoul(source.substr(pos, len), tail, hex ? 16 : 10);
-                    if (*tail == len and entity_code <= UNICODE_MAX)
-                        target.append(get_dec_entity(entity_code));
-                    ++end_pos;
-                } catch (std::invalid_argument const& ex){
+                auto result = std::from_chars(source.data() + pos, source.data() + end_pos, entity_code, hex ? 16 : 10);
+                if (result.ec == std::errc::invalid_argument) {
                     // invalid numeric entity code
                     // append the consumed chars
                     target.append(source, pos, end_pos-pos);
+                } else {
+                    // codes too large for entity_code are left out like any other past UNICODE_MAX
+                    if (result.ec == std::errc() and result.ptr == source.data() + end_pos and entity_code <= UNICODE_MAX)
+                        target.append(get_dec_entity(entity_code));
+                    ++end_pos;
                 }
             }
             else { // proper named entity
@@ -97,7 +95,6 @@ namespace entities {
         }
         // append the rest of the string
         target.append(source, end_pos, pos-end_pos);
-        delete tail;
     }
 
     // &npsp; &thinsp; etc are treated as normal spaces
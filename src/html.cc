@@ -9,7 +9,7 @@
 namespace warc2text {
 
     // true if doc is ok
-    bool filter(const std::string& lc_tag, const char* attr, const char* value, const util::umap_tag_filters_regex& tagFilters) {
+    bool filter(const std::string& lc_tag, const char* attr, std::string_view value, const util::umap_tag_filters_regex& tagFilters) {
         util::umap_tag_filters_regex::const_iterator tag_it = tagFilters.find(lc_tag);
         if (tag_it == tagFilters.cend())
             return true;
@@ -17,7 +17,7 @@ namespace warc2text {
         if (attr_it == tag_it->second.cend())
             return true;
         for (const util::umap_attr_regex& filter : attr_it->second){
-            if (std::regex_search(value, filter.regex)) {
+            if (std::regex_search(value.begin(), value.end(), filter.regex)) {
                 BOOST_LOG_TRIVIAL(debug) << "Tag filter " << tag_it->first << "[" << attr_it->first << " ~ " << filter.str << "] matched '" << value << "'";
                 return false;
             }
@@ -41,10 +41,11 @@ namespace warc2text {
         }
     }
 
-    int processHTML(const std::string& html, std::string& plaintext, const util::umap_tag_filters_regex& tagFilters){
+    int processHTML(std::string_view html, std::string& plaintext, const util::umap_tag_filters_regex& tagFilters){
         plaintext = "";
-        markup::instream si(html.c_str());
-        markup::scanner sc(si);
+        // the document ends at the first NUL, as if it was read as a C string
+        const char* end = static_cast<const char*>(std::memchr(html.data(), '\0', html.size()));
+        markup::scanner sc(html.data(), end ? end : html.data() + html.size());
 
         int t = markup::scanner::TT_SPACE; // just start somewhere that isn't ERROR or EOF
         int retval = util::SUCCESS;
@@ -60,7 +61,8 @@ namespace warc2text {
                 case markup::scanner::TT_TAG_START:
                 case markup::scanner::TT_TAG_END:
                     // sc.get_tag_name() only changes value after a new tag is found
-                    tag = util::toLowerCopy(sc.get_tag_name());
+                    tag.assign(sc.get_tag_name());
+                    util::toLower(tag);
                     // found block tag: previous block has ended
                     if (html::isBlockTag(tag)) addNewLine(plaintext);
                     // found void tag, like <img> or <embed>
@@ -82,7 +84,7 @@ namespace warc2text {
                     break;
             }
         }
-        if (plaintext.back() != '\n') plaintext.push_back('\n');
+        if (plaintext.empty() || plaintext.back() != '\n') plaintext.push_back('\n');
         return retval;
     }
 
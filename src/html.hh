@@ -2,9 +2,10 @@
 #define WARC2TEXT_HTML_HH
 
 #include <string>
+#include <string_view>
 
 namespace warc2text {
-    int processHTML(const std::string& html, std::string& text, const util::umap_tag_filters_regex& tagFilters);
+    int processHTML(std::string_view html, std::string& text, const util::umap_tag_filters_regex& tagFilters);
 }
 
 #endif
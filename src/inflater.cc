@@ -0,0 +1,99 @@
+#include "inflater.hh"
+#include <algorithm>
+#include <cstring>
+
+#ifdef WITH_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+namespace warc2text {
+#ifdef WITH_LIBDEFLATE
+    class LibdeflateInflater : public MemberInflater {
+        private:
+            libdeflate_decompressor* decompressor;
+
+        public:
+            LibdeflateInflater() : decompressor(libdeflate_alloc_decompressor()) {}
+
+            ~LibdeflateInflater() override {
+                libdeflate_free_decompressor(decompressor);
+            }
+
+            bool inflate(const uint8_t* in, std::size_t in_len, std::string& out, std::size_t max_size, std::size_t& consumed) override {
+                if (!decompressor)
+                    return false;
+                // Past max_size streaming takes over, which skips the record.
+                const uint64_t limit = max_size < out.max_size() ? max_size + 1 : max_size;
+                // The inflated size modulo 4 GiB is in the trailer of the member, which ends where the
+                // next member starts or at the end of the input. If it wrapped, or the next header was
+                // found by chance inside compressed data, the member does not fit and is inflated once
+                // more with all the room it may need.
+                const uint8_t* end = in + in_len;
+                const uint8_t* next = in_len > MIN_MEMBER_SIZE ? findGzipHeader(in + MIN_MEMBER_SIZE, end) : end;
+                uint64_t size = limit;
+                if (next - in >= static_cast<std::ptrdiff_t>(MIN_MEMBER_SIZE)) {
+                    const uint8_t* isize = next - 4;
+                    size = std::min<uint64_t>(uint32_t(isize[0]) | uint32_t(isize[1]) << 8 | uint32_t(isize[2]) << 16 | uint32_t(isize[3]) << 24, limit);
+                }
+                while (true) {
+                    out.resize(size);
+                    std::size_t inflated = 0;
+                    libdeflate_result result = libdeflate_gzip_decompress_ex(decompressor, in, in_len, &out[0], out.size(), &consumed, &inflated);
+                    if (result == LIBDEFLATE_SUCCESS && inflated <= max_size) {
+                        out.resize(inflated);
+                        return true;
+                    }
+                    if (result != LIBDEFLATE_INSUFFICIENT_SPACE || size >= limit) {
+                        // truncated, corrupt or too large
+                        out.clear();
+                        return false;
+                    }
+                    size = std::min(size + (uint64_t(1) << 32), limit);
+                }
+            }
+
+        private:
+            // gzip header, an empty deflate block and the trailer
+            static const std::size_t MIN_MEMBER_SIZE = 20;
+    };
+#endif
+
+    const uint8_t* findGzipHeader(const uint8_t* p, const uint8_t* end) {
+        for (; end - p >= 4; ++p) {
+            p = static_cast<const uint8_t*>(std::memchr(p, 0x1f, end - p - 3));
+            if (!p)
+                return end;
+            if (p[1] == 0x8b && p[2] == 0x08 && (p[3] & 0xe0) == 0)
+                return p;
+        }
+        return end;
+    }
+
+    bool parseInflateEngine(const std::string& name, InflateEngine& engine) {
+        if (name == "zlib") {
+            engine = InflateEngine::zlib;
+            return true;
+        }
+#ifdef WITH_LIBDEFLATE
+        if (name == "libdeflate") {
+            engine = InflateEngine::libdeflate;
+            return true;
+        }
+#endif
+        return false;
+    }
+
+    std::unique_ptr<MemberInflater> makeMemberInflater(InflateEngine engine) {
+        switch (engine) {
+            case InflateEngine::libdeflate:
+#ifdef WITH_LIBDEFLATE
+                return std::make_unique<LibdeflateInflater>();
+#else
+                return nullptr;
+#endif
+            case InflateEngine::zlib:
+                return nullptr;
+        }
+        return nullptr;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef WARC2TEXT_INFLATER_HH
+#define WARC2TEXT_INFLATER_HH
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace warc2text {
+    enum class InflateEngine { zlib, libdeflate };
+
+    /**
+     * Decompresses a gzip member that is completely in memory with a single call.
+     * For the small members records are usually stored in this is a lot faster than
+     * streaming through zlib. Anything it cannot handle in one go (a member that goes
+     * past the end of the input, is corrupt, or would inflate to more than max_size)
+     * is left to the streaming zlib inflater of WARCReader.
+     */
+    class MemberInflater {
+        public:
+            // inflate the member at the start of in into out and set consumed to its compressed
+            // size. Returns false if the member has to be inflated by streaming instead.
+            virtual bool inflate(const uint8_t* in, std::size_t in_len, std::string& out, std::size_t max_size, std::size_t& consumed) = 0;
+            virtual ~MemberInflater() = default;
+    };
+
+    // first position in [p, end) that looks like the start of a gzip member: the gzip magic, the
+    // deflate method and no reserved flags set. Returns end if there is none. The same bytes can
+    // show up by chance inside compressed data.
+    const uint8_t* findGzipHeader(const uint8_t* p, const uint8_t* end);
+
+    // parse an engine name, returns false if it is unknown or not compiled in
+    bool parseInflateEngine(const std::string& name, InflateEngine& engine);
+
+    // whole member inflater for engine, nullptr if the engine only streams (zlib)
+    std::unique_ptr<MemberInflater> makeMemberInflater(InflateEngine engine);
+}
+
+#endif
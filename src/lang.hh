@@ -15,13 +15,17 @@ class LanguageDetector {
   public:
     virtual ~LanguageDetector() {};
 
-    // detect language of plain text, return top languages
+    // detect language of plain text, return top languages.
+    // The process threads all call detect() on the same detector at the same time, so it
+    // must keep the state of a detection to itself and only read what the detector holds.
     virtual void detect(const std::string& text, std::unordered_map<std::string, std::string>& chunks) const = 0;
 
     // Label used for text (chunks) that cannot reliably be identified
     static const std::string kUnknownLanguageLabel;
 };
 
+// predict() is const and keeps the hidden and output vectors of each call in a
+// Model::State of its own, so the model is shared by all threads read-only
 class FastTextDetector : public LanguageDetector {
   public:
     explicit FastTextDetector(const std::string &filename);
@@ -32,6 +36,7 @@ class FastTextDetector : public LanguageDetector {
     std::unique_ptr<fasttext::FastText> classifier_;
 };
 
+// CLD2 keeps the state of a detection on the stack and only reads its static tables
 class CLD2Detector : public LanguageDetector {
 public:
   virtual void detect(const std::string& text, std::unordered_map<std::string, std::string>& chunks) const;
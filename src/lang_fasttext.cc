@@ -5,9 +5,14 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <type_traits>
 
 namespace warc2text {
 
+// detect() is called from several threads at the same time, which is only safe with the
+// fastText versions whose predict() keeps its scratch space in a Model::State per call
+static_assert(std::is_class<fasttext::Model::State>::value, "fastText predict() must keep its state per call");
+
 FastTextDetector::FastTextDetector(const std::string &filename)
   : classifier_(new fasttext::FastText) {
   classifier_->loadModel(filename);
@@ -0,0 +1,297 @@
+#include "parallelreader.hh"
+#include "zlib.h"
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <stdlib.h>
+
+namespace {
+    // one z_stream per worker thread, reset for every member
+    struct Inflater {
+        z_stream s{};
+
+        Inflater() {
+            if (inflateInit2(&s, 32) != Z_OK) {
+                BOOST_LOG_TRIVIAL(error) << "Failed to init zlib";
+                abort();
+            }
+        }
+
+        ~Inflater() {
+            inflateEnd(&s);
+        }
+    };
+}
+
+namespace warc2text {
+    ParallelWARCReader::ParallelWARCReader(const std::string& filename, unsigned threads, std::size_t max_size, std::size_t window_size) :
+        file(openWARCFile(filename)),
+        warc_filename(filename),
+        max_size(max_size),
+        window(),
+        window_capacity(std::max<std::size_t>(1, window_size) * std::max(1u, threads)),
+        window_offset(0),
+        offset(0),
+        last_offset(std::numeric_limits<std::size_t>::max()),
+        eof(false),
+        candidates(),
+        next_candidate(0),
+        inflating(),
+        max_inflating(std::max(1u, threads) * 8),
+        tasks(std::max(1u, threads) * 8)
+    {
+        for (unsigned i = 0; i < std::max(1u, threads); ++i) {
+            workers.emplace_back([this]{
+                // an empty task tells the worker to stop
+                for (Task task = tasks.pop(); task.valid(); task = tasks.pop())
+                    task();
+            });
+        }
+    }
+
+    ParallelWARCReader::~ParallelWARCReader() {
+        drain();
+        for (std::size_t i = 0; i < workers.size(); ++i)
+            tasks.push(Task());
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    std::size_t ParallelWARCReader::tell() const {
+        return offset;
+    }
+
+    void ParallelWARCReader::setRange(std::size_t start, std::size_t end) {
+        last_offset = end;
+        skipTo(start > offset ? findMember(start) : offset);
+    }
+
+    std::size_t ParallelWARCReader::findMember(std::size_t start) {
+        // go through the candidates the window was scanned for, reading on where they run out
+        skipTo(start);
+        while (true) {
+            auto candidate = std::lower_bound(candidates.begin(), candidates.end(), offset);
+            for (; candidate != candidates.end(); ++candidate) {
+                std::size_t at = *candidate - window_offset;
+                Probe probe = probeMember(window.data() + at, window.size() - at);
+                if (probe == Probe::record)
+                    return *candidate;
+                if (probe == Probe::truncated && !eof)
+                    break;
+            }
+            if (candidate == candidates.end() && eof)
+                return window_offset + window.size();
+            // keep the candidate that needs more input, or the last bytes that may start a header
+            if (candidate != candidates.end())
+                offset = *candidate;
+            else
+                offset = std::max(offset, window_offset + window.size() - std::min<std::size_t>(window.size(), 3));
+            fill();
+        }
+    }
+
+    ParallelWARCReader::Probe ParallelWARCReader::probeMember(const uint8_t* data, std::size_t len) {
+        static thread_local Inflater inflater;
+        z_stream& s = inflater.s;
+        if (inflateReset(&s) != Z_OK) {
+            BOOST_LOG_TRIVIAL(error) << "Failed to reset zlib";
+            abort();
+        }
+        std::array<uint8_t, 7> head;
+        s.next_in = const_cast<Bytef*>(data);
+        s.avail_in = len;
+        s.next_out = head.data();
+        s.avail_out = head.size();
+        int inflate_ret = Z_OK;
+        while (s.avail_out > 0 && inflate_ret == Z_OK)
+            inflate_ret = inflate(&s, Z_NO_FLUSH);
+        if (s.avail_out == 0)
+            return std::memcmp(head.data(), "WARC/1.", head.size()) == 0 ? Probe::record : Probe::not_record;
+        return inflate_ret == Z_BUF_ERROR ? Probe::truncated : Probe::not_record;
+    }
+
+    void ParallelWARCReader::skipTo(std::size_t next) {
+        drain();
+        offset = next;
+        if (offset - window_offset <= window.size())
+            return;
+        // past the window, start reading again from there
+        window.clear();
+        candidates.clear();
+        next_candidate = 0;
+        window_offset = offset;
+        eof = false;
+        if (fseeko(file.get(), offset, SEEK_SET) != 0) {
+            BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": could not seek to offset " << offset;
+            throw WARCFileException();
+        }
+    }
+
+    void ParallelWARCReader::drain() {
+        // workers read straight from the window, so wait for them before it is touched
+        for (auto& candidate : inflating)
+            candidate.second.wait();
+        inflating.clear();
+    }
+
+    void ParallelWARCReader::fill() {
+        drain();
+
+        // keep the unfinished member at the end of the window, grow the window if that
+        // member alone does not fit in it
+        std::size_t keep_from = offset - window_offset;
+        if (keep_from == 0 && window.size() >= window_capacity)
+            window_capacity *= 2;
+        window.erase(window.begin(), window.begin() + keep_from);
+        window_offset = offset;
+
+        std::size_t have = window.size();
+        window.resize(window_capacity);
+        std::size_t len = std::fread(window.data() + have, sizeof(uint8_t), window_capacity - have, file.get());
+        window.resize(have + len);
+        if (std::ferror(file.get()) && !std::feof(file.get())) {
+            BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": error during reading";
+            throw WARCFileException();
+        }
+        if (std::feof(file.get()))
+            eof = true;
+        if (window_offset == 0 && !window.empty() && window[0] != 0x1f) {
+            BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": only gzip compressed WARCs can be inflated on several threads";
+            throw WARCFileException();
+        }
+
+        // anything starting with the gzip magic, deflate method and no reserved flags set
+        candidates.clear();
+        next_candidate = 0;
+        const uint8_t* begin = window.data();
+        const uint8_t* end = window.data() + window.size();
+        for (const uint8_t* p = begin; end - p >= 4; ++p) {
+            p = static_cast<const uint8_t*>(std::memchr(p, 0x1f, end - p - 3));
+            if (!p)
+                break;
+            if (p[1] == 0x8b && p[2] == 0x08 && (p[3] & 0xe0) == 0)
+                candidates.push_back(window_offset + (p - begin));
+        }
+    }
+
+    void ParallelWARCReader::dispatch() {
+        while (inflating.size() < max_inflating && next_candidate < candidates.size()) {
+            std::size_t start = candidates[next_candidate++] - window_offset;
+            const uint8_t* data = window.data() + start;
+            std::size_t len = window.size() - start;
+            std::size_t limit = max_size;
+            Task task([data, len, limit]{ return inflateMember(data, len, limit, true); });
+            inflating.emplace_back(window_offset + start, task.get_future());
+            tasks.push(std::move(task));
+        }
+    }
+
+    std::size_t ParallelWARCReader::getRecord(std::string& out, std::size_t max_size) {
+        out.clear();
+        while (true) {
+            if (offset >= last_offset)
+                return 0;
+            if (offset - window_offset >= window.size()) {
+                // nothing more to read
+                if (eof)
+                    return 0;
+                fill();
+                continue;
+            }
+
+            // forget the candidates that turned out to be inside the previous member
+            while (!inflating.empty() && inflating.front().first < offset) {
+                inflating.front().second.wait();
+                inflating.pop_front();
+            }
+            if (inflating.empty())
+                while (next_candidate < candidates.size() && candidates[next_candidate] < offset)
+                    ++next_candidate;
+            dispatch();
+
+            Member member;
+            if (!inflating.empty() && inflating.front().first == offset) {
+                member = inflating.front().second.get();
+                inflating.pop_front();
+            }
+            // no candidate here, or not a WARC record: do it the slow way to get the same result as WARCReader
+            if (member.status != Member::Status::ok) {
+                std::size_t start = offset - window_offset;
+                member = inflateMember(window.data() + start, window.size() - start, this->max_size, false);
+            }
+
+            if (member.status == Member::Status::truncated) {
+                // nothing more to read
+                if (eof)
+                    return 0;
+                fill();
+                continue;
+            }
+            if (member.status == Member::Status::error && recover) {
+                std::size_t corrupt = offset;
+                skipTo(findMember(corrupt + 1));
+                BOOST_LOG_TRIVIAL(warning) << "WARC " << warc_filename << ": corrupt record at offset " << corrupt
+                    << ", skipped " << offset - corrupt << " bytes up to offset " << offset;
+                ++skipped.ranges;
+                skipped.bytes += offset - corrupt;
+                return offset - corrupt;
+            }
+            if (member.status == Member::Status::error) {
+                BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": error during decompressing";
+                throw WARCFileException();
+            }
+
+            offset += member.length;
+            if (member.skipped || member.content.size() > max_size)
+                BOOST_LOG_TRIVIAL(trace) << "WARC " << warc_filename << ": skipping large record";
+            else if (acceptHeader(member.content))
+                out = std::move(member.content);
+            return member.length;
+        }
+    }
+
+    ParallelWARCReader::Member ParallelWARCReader::inflateMember(const uint8_t* data, std::size_t len, std::size_t max_size, bool speculative) {
+        static thread_local Inflater inflater;
+        z_stream& s = inflater.s;
+        if (inflateReset(&s) != Z_OK) {
+            BOOST_LOG_TRIVIAL(error) << "Failed to reset zlib";
+            abort();
+        }
+        s.next_in = const_cast<Bytef*>(data);
+        s.avail_in = len;
+
+        Member member;
+        std::array<uint8_t, 65536> scratch;
+        int inflate_ret = Z_OK;
+        while (inflate_ret != Z_STREAM_END) {
+            s.next_out = scratch.data();
+            s.avail_out = scratch.size();
+            inflate_ret = inflate(&s, Z_NO_FLUSH);
+            if (inflate_ret == Z_BUF_ERROR) {
+                // ran out of input before the end of the member
+                member.status = Member::Status::truncated;
+                return member;
+            }
+            if (inflate_ret != Z_OK && inflate_ret != Z_STREAM_END) {
+                member.status = Member::Status::error;
+                return member;
+            }
+            if (!member.skipped)
+                member.content.append(scratch.data(), scratch.data() + (scratch.size() - s.avail_out));
+            if (member.content.size() > max_size) {
+                member.content.clear();
+                member.skipped = true;
+            }
+            // give up early on something that only looked like a gzip header
+            if (speculative && !member.skipped && member.content.size() >= 5 && member.content.compare(0, 5, "WARC/") != 0) {
+                member.status = Member::Status::not_warc;
+                return member;
+            }
+        }
+        member.status = Member::Status::ok;
+        member.length = len - s.avail_in;
+        return member;
+    }
+}
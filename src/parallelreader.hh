@@ -0,0 +1,79 @@
+#ifndef WARC2TEXT_PARALLELREADER_HH
+#define WARC2TEXT_PARALLELREADER_HH
+
+#include "warcreader.hh"
+#include "queue.hh"
+#include "util/file.hh"
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace warc2text {
+    /**
+     * Reader for gzipped WARCs that inflates records on a pool of threads.
+     *
+     * The input is read in large windows. Every window is scanned for gzip member
+     * headers, and each candidate is inflated by a worker ahead of the consumer.
+     * Because a gzip header can also show up by chance inside compressed data, the
+     * members are chained from the start of the file: a candidate is only used if the
+     * previous member ends exactly where it starts, and everything else is thrown away.
+     * Records and offsets are therefore the same as the ones WARCReader returns.
+     */
+    class ParallelWARCReader : public RecordReader {
+        public:
+            // window_size is how much of the file is read at once for each thread; it grows for members that do not fit
+            ParallelWARCReader(const std::string& filename, unsigned threads, std::size_t max_size = 1024*1024*20,
+                               std::size_t window_size = 4*1024*1024);
+            std::size_t getRecord(std::string& out, std::size_t max_size = 1024*1024*20) override;
+            std::size_t tell() const override;
+            // only read the records that start at or after start and before end, like WARCReader::setRange
+            void setRange(std::size_t start, std::size_t end);
+            ~ParallelWARCReader() override;
+
+        private:
+            struct Member {
+                enum class Status { ok, truncated, error, not_warc };
+                Status status = Status::truncated;
+                std::size_t length = 0; // compressed length
+                std::string content; // inflated record, empty if skipped
+                bool skipped = false; // larger than max_size
+            };
+            using Task = std::packaged_task<Member()>;
+            // whether a candidate inflates to the start of a WARC record
+            enum class Probe { record, not_record, truncated };
+
+            util::scoped_FILE file;
+            std::string warc_filename;
+            std::size_t max_size;
+
+            std::vector<uint8_t> window;
+            std::size_t window_capacity;
+            std::size_t window_offset; // offset in the file of window[0]
+            std::size_t offset; // offset in the file of the next member
+            std::size_t last_offset; // no member starting at or after this offset is read
+            bool eof;
+
+            std::vector<std::size_t> candidates; // file offsets of what looks like a gzip header in the window
+            std::size_t next_candidate; // first candidate not handed to the workers yet
+            std::deque<std::pair<std::size_t, std::future<Member>>> inflating;
+            std::size_t max_inflating;
+
+            util::BoundedQueue<Task> tasks;
+            std::vector<std::thread> workers;
+
+            void fill();
+            void dispatch();
+            void drain();
+            // offset of the first member at or after start that holds a record, read from the window
+            std::size_t findMember(std::size_t start);
+            static Probe probeMember(const uint8_t* data, std::size_t len);
+            void skipTo(std::size_t next);
+            static Member inflateMember(const uint8_t* data, std::size_t len, std::size_t max_size, bool speculative);
+    };
+}
+
+#endif
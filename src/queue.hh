@@ -0,0 +1,80 @@
+#ifndef WARC2TEXT_QUEUE_HH
+#define WARC2TEXT_QUEUE_HH
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace util {
+    /**
+     * Blocking producer/consumer queue with a fixed capacity.
+     * push() blocks while the queue is full and pop() blocks while it is empty,
+     * so a slow consumer throttles its producers instead of letting memory grow.
+     */
+    template <typename T>
+    class BoundedQueue {
+        private:
+            std::deque<T> items;
+            std::size_t capacity;
+            std::mutex mutex;
+            std::condition_variable not_full;
+            std::condition_variable not_empty;
+
+        public:
+            explicit BoundedQueue(std::size_t capacity) : capacity(capacity == 0 ? 1 : capacity) {}
+
+            void push(T&& item) {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_full.wait(lock, [this]{ return items.size() < capacity; });
+                items.push_back(std::move(item));
+                lock.unlock();
+                not_empty.notify_one();
+            }
+
+            T pop() {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_empty.wait(lock, [this]{ return !items.empty(); });
+                T item = std::move(items.front());
+                items.pop_front();
+                lock.unlock();
+                not_full.notify_one();
+                return item;
+            }
+    };
+
+    /**
+     * Objects handed back to be used again, kept up to a fixed number. take() does not
+     * wait: it returns nullptr when there is nothing to reuse, and give() drops what does
+     * not fit.
+     */
+    template <typename T>
+    class Pool {
+        private:
+            std::vector<std::unique_ptr<T>> items;
+            std::size_t capacity;
+            std::mutex mutex;
+
+        public:
+            explicit Pool(std::size_t capacity) : capacity(capacity) {}
+
+            std::unique_ptr<T> take() {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (items.empty())
+                    return nullptr;
+                std::unique_ptr<T> item = std::move(items.back());
+                items.pop_back();
+                return item;
+            }
+
+            void give(std::unique_ptr<T>&& item) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (items.size() < capacity)
+                    items.push_back(std::move(item));
+            }
+    };
+}
+
+#endif
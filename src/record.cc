@@ -8,7 +8,7 @@
 #include "entities.hh"
 #include "zipreader.hh"
 #include <boost/log/trivial.hpp>
-#include <boost/locale.hpp>
+#include <algorithm>
 #include <boost/algorithm/string/predicate.hpp>
 
 #include "decompress.hh"
@@ -17,115 +17,300 @@ namespace warc2text {
     const std::unordered_set<std::string> Record::textContentTypes = {"text/plain", "text/html", "application/xml", "text/vnd.wap.wml", "application/atom+xml", "application/opensearchdescription+xml", "application/rss+xml", "application/xhtml+xml"};
 
 
-    std::size_t read_header(const std::string& content, std::size_t last_pos, std::unordered_map<std::string,std::string>& header) {
-        std::string line;
-        std::size_t header_end = content.find("\r\n\r\n", last_pos);
-        std::size_t pos;
-        if (header_end == std::string::npos) return std::string::npos;
-        pos = content.find(':', last_pos);
-        while (pos < header_end){
-            line = content.substr(last_pos, pos - last_pos);
-            pos = content.find_first_not_of(' ', pos + 1);
-            last_pos = pos;
-            pos = content.find("\r\n", pos);
-            // normalize header keys case
-            util::toLower(line);
-            header[line] = content.substr(last_pos, pos - last_pos);
-            // util::toLower(header[line]);
-            last_pos = pos + 2;
-            pos = content.find(':', last_pos);
+    namespace {
+        inline char lowerASCII(char c) {
+            return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
         }
-        return header_end + 4;
+
+        bool equalsIgnoringCase(std::string_view a, std::string_view b) {
+            if (a.size() != b.size())
+                return false;
+            for (std::size_t i = 0; i < a.size(); ++i)
+                if (lowerASCII(a[i]) != lowerASCII(b[i]))
+                    return false;
+            return true;
+        }
+
+        const std::string_view fieldNames[HeaderTable::n_fields] = {
+            "warc-type",
+            "warc-target-uri",
+            "warc-date",
+            "warc-record-id",
+            "warc-payload-digest",
+            "content-type",
+            "content-length",
+            "content-encoding",
+            "transfer-encoding",
+            "status",
+        };
     }
 
-    Record::Record(const std::string& content, const std::string& filename, std::size_t size, std::size_t offset) :
-        filename(filename),
-        size(size),
-        offset(offset)
-    {
-        std::string line;
-        std::size_t last_pos = 0, payload_start = 0;
-        std::size_t pos = content.find("WARC/1.0\r\n");
-        if (pos != 0) {
-            BOOST_LOG_TRIVIAL(error) << "WARC version line not found";
+    HeaderTable::Field HeaderTable::field(std::string_view name) {
+        for (unsigned f = 0; f < n_fields; ++f)
+            if (equalsIgnoringCase(name, fieldNames[f]))
+                return static_cast<Field>(f);
+        return other;
+    }
+
+    void HeaderTable::set(std::string_view name, std::string_view value) {
+        Field f = field(name);
+        if (f != other) {
+            set(f, value);
             return;
         }
-        last_pos = pos + 10;
-        // parse WARC header
-        last_pos = read_header(content, last_pos, header);
+        // a repeated field replaces the one before, like the rest
+        for (std::size_t i = 0; i < others.size(); ++i) {
+            if (equalsIgnoringCase(others[i].first, name)) {
+                others[i].second = value;
+                last = n_fields + i;
+                return;
+            }
+        }
+        others.emplace_back(name, value);
+        last = n_fields + others.size() - 1;
+    }
 
-        if (last_pos == std::string::npos) {
-            BOOST_LOG_TRIVIAL(error) << "Could not parse WARC header";
+    const std::string_view* HeaderTable::find(std::string_view name) const {
+        Field f = field(name);
+        if (f != other)
+            return has(f) ? &known[f] : nullptr;
+        for (const auto& entry : others)
+            if (equalsIgnoringCase(entry.first, name))
+                return &entry.second;
+        return nullptr;
+    }
+
+    void HeaderTable::set(Field f, std::string_view value) {
+        known[f] = value;
+        present |= 1u << f;
+        last = f;
+    }
+
+    void HeaderTable::fold(std::string_view continuation) {
+        std::string_view* value = last < n_fields ? &known[last]
+            : last - n_fields < others.size() ? &others[last - n_fields].second : nullptr;
+        // a continuation line before any field has nothing to continue
+        if (!value)
             return;
+        // the only field values that get copied, into a list so that the views stay put
+        unfolded.emplace_front(*value);
+        unfolded.front().append(1, ' ').append(continuation);
+        *value = unfolded.front();
+    }
+
+    void HeaderTable::clear() {
+        std::fill(std::begin(known), std::end(known), std::string_view());
+        present = 0;
+        others.clear();
+        unfolded.clear();
+        last = no_field;
+    }
+
+    // position after the version line content starts with, npos if it does not start with one
+    std::size_t read_version_line(std::string_view content) {
+        if (content.compare(0, 8, "WARC/1.0") != 0)
+            return std::string_view::npos;
+        if (content.compare(8, 2, "\r\n") == 0)
+            return 10;
+        if (content.compare(8, 1, "\n") == 0)
+            return 9;
+        return std::string_view::npos;
+    }
+
+    // Reads the header fields from pos up to the empty line that ends them, looking at each byte
+    // once to find the line ends and once more to find the colon of a field. Lines end in CRLF or
+    // a bare LF, and lines starting with a space or a tab continue the value of the field before.
+    // Returns the position after the empty line, npos if the header does not end.
+    std::size_t read_header(std::string_view content, std::size_t pos, HeaderTable& header) {
+        while (pos < content.size()) {
+            std::size_t eol = content.find('\n', pos);
+            if (eol == std::string_view::npos)
+                return std::string_view::npos;
+            std::size_t end = eol > pos && content[eol - 1] == '\r' ? eol - 1 : eol;
+            std::string_view line = content.substr(pos, end - pos);
+            pos = eol + 1;
+
+            if (line.empty())
+                return pos;
+
+            if (line[0] == ' ' || line[0] == '\t') {
+                line.remove_prefix(std::min(line.find_first_not_of(" \t"), line.size()));
+                header.fold(line);
+                continue;
+            }
+
+            // not a field, skip it
+            std::size_t colon = line.find(':');
+            if (colon == std::string_view::npos)
+                continue;
+
+            std::string_view value = line.substr(colon + 1);
+            value.remove_prefix(std::min(value.find_first_not_of(" \t"), value.size()));
+            header.set(line.substr(0, colon), value);
         }
+        return std::string_view::npos;
+    }
 
-        // get the most important stuff:
+    // pick the fields out of the WARC header that are kept apart
+    void read_warc_fields(const HeaderTable& header, std::string& recordType, std::string& url, std::string& WARCcontentType) {
         // TODO: check for mandatory header fields
-        if (header.count("warc-type") == 1) {
-            recordType = header["warc-type"];
+        if (header.has(HeaderTable::warc_type)) {
+            recordType = header.get(HeaderTable::warc_type);
             util::toLower(recordType);
         }
 
-        if (header.count("warc-target-uri") == 1) {
+        if (header.has(HeaderTable::warc_target_uri)) {
             // respect the original casing
-            url = header["warc-target-uri"];
+            url = header.get(HeaderTable::warc_target_uri);
 
             // Remove any "<" and ">" wrappings from the URL
             if (!url.empty() && url[0] == '<' && url[url.size()-1] == '>')
                 url = url.substr(1, url.size()-2);
         }
 
-        if (header.count("content-type") == 1) {
-            WARCcontentType = header["content-type"];
+        if (header.has(HeaderTable::content_type)) {
+            WARCcontentType = header.get(HeaderTable::content_type);
             util::toLower(WARCcontentType);
         }
+    }
+
+    RecordHeader::RecordHeader(std::string_view content) {
+        std::size_t pos = read_version_line(content);
+        if (pos == std::string_view::npos)
+            return;
+        if (read_header(content, pos, header) == std::string_view::npos)
+            return;
+        read_warc_fields(header, recordType, url, WARCcontentType);
+        valid = true;
+    }
 
-        if (header.count("warc-date") == 1) {
-            WARCdate = header["warc-date"];
+    Record::Record(std::string record_content, const std::string& filename, std::size_t size, std::size_t offset) :
+        filename(&filename),
+        size(size),
+        offset(offset),
+        content(std::move(record_content))
+    {
+        parse();
+    }
+
+    void Record::reset(std::string record_content, const std::string& record_filename, std::size_t record_size, std::size_t record_offset) {
+        filename = &record_filename;
+        size = record_size;
+        offset = record_offset;
+        content = std::move(record_content);
+
+        // clear() keeps the capacity of the strings and tables, which is the point of reusing the record
+        header.clear();
+        HTTPheader.clear();
+        payload = std::string_view();
+        decoded.clear();
+        plaintext.clear();
+        language.clear();
+        text_by_langs.clear();
+        recordType.clear();
+        WARCcontentType.clear();
+        WARCdate.clear();
+        cleanHTTPcontentType.clear();
+        charset.clear();
+        url.clear();
+        bdf_zip = false;
+
+        parse();
+    }
+
+    void Record::parse() {
+        std::string_view view(content);
+        std::size_t last_pos = 0, payload_start = 0;
+        last_pos = read_version_line(view);
+        if (last_pos == std::string_view::npos) {
+            BOOST_LOG_TRIVIAL(error) << "WARC version line not found";
+            return;
+        }
+        // parse WARC header
+        last_pos = read_header(view, last_pos, header);
+
+        if (last_pos == std::string_view::npos) {
+            BOOST_LOG_TRIVIAL(error) << "Could not parse WARC header";
+            return;
+        }
+
+        // get the most important stuff:
+        read_warc_fields(header, recordType, url, WARCcontentType);
+
+        if (header.has(HeaderTable::warc_date)) {
+            WARCdate = header.get(HeaderTable::warc_date);
         }
 
         payload_start = last_pos;
         if (recordType == "response") {
             // parse HTTP header
-            pos = content.find("HTTP/1.", last_pos);
-            if (pos == last_pos) { // found HTTP header
-                // parse HTTP status code
-                std::size_t space = content.find(" ", last_pos);
-                pos = content.find("\r\n", last_pos);
-                HTTPheader["status"] = content.substr(space + 1, (pos - space) - 1);
-
-                payload_start = read_header(content, pos + 2, HTTPheader);
-                if (payload_start == std::string::npos) {
+            std::size_t eol = view.find('\n', last_pos);
+            if (view.compare(last_pos, 7, "HTTP/1.") == 0 && eol != std::string_view::npos) { // found HTTP header
+                // parse HTTP status code: what comes after the protocol on the status line
+                std::size_t end = view[eol - 1] == '\r' ? eol - 1 : eol;
+                std::string_view status_line = view.substr(last_pos, end - last_pos);
+                std::size_t space = status_line.find(' ');
+                std::string_view status = space == std::string_view::npos ? std::string_view() : status_line.substr(space + 1);
+
+                payload_start = read_header(view, eol + 1, HTTPheader);
+                if (payload_start == std::string_view::npos) {
                     // BOOST_LOG_TRIVIAL(warning) << "Response record without HTTP header";
+                    HTTPheader.clear();
                     payload_start = last_pos; // could not parse the header, so treat it as part of the payload
                 }
+                // a Status field in the header wins over the status line, as it always did
+                if (!HTTPheader.has(HeaderTable::status))
+                    HTTPheader.set(HeaderTable::status, status);
             }
             // else {
             //     BOOST_LOG_TRIVIAL(warning) << "Response record without HTTP header";
             // }
 
-            if (HTTPheader.count("content-type") == 1)
-                cleanContentType(HTTPheader["content-type"]);
+            if (HTTPheader.has(HeaderTable::content_type))
+                cleanContentType(HTTPheader.get(HeaderTable::content_type));
         }
 
-        payload = std::string(content, payload_start, std::string::npos);
+        payload = view.substr(payload_start);
         util::trim(payload); //remove \r\n\r\n at the end
+    }
 
-        try {
-            if (HTTPheader.count("transfer-encoding") > 0) {
-                if (HTTPheader["transfer-encoding"] == "chunked")
-                    dechunk(payload);
-                else
-                    throw std::invalid_argument("Unsupported HTTP Transfer-Encoding:" + HTTPheader["transfer-encoding"]);
+    void Record::decodePayload(std::size_t max_size) {
+        // only dechunking and decoding rewrite the payload, into decoded
+        std::string error;
+        bool dechunked = false;
+        if (HTTPheader.has(HeaderTable::transfer_encoding)) {
+            if (HTTPheader.get(HeaderTable::transfer_encoding) == "chunked") {
+                decoded = payload;
+                DechunkStatus status = dechunk(decoded);
+                payload = decoded;
+                dechunked = true;
+                if (status != DechunkStatus::ok)
+                    error = describe(status);
+            } else
+                error = "Unsupported HTTP Transfer-Encoding:" + std::string(HTTPheader.get(HeaderTable::transfer_encoding));
+        }
+        if (error.empty() && HTTPheader.has(HeaderTable::content_encoding)) {
+            std::string encoding(HTTPheader.get(HeaderTable::content_encoding));
+            util::toLower(encoding);
+            if (noncompressed_content_encodings.count(encoding) == 0) {
+                // decoded holds the payload already if it was dechunked
+                std::string inflated;
+                std::string& target = dechunked ? inflated : decoded;
+                DecodeStatus status = decodeContent(payload, encoding, target, max_size);
+                if (status == DecodeStatus::ok) {
+                    if (dechunked)
+                        decoded.swap(inflated);
+                    payload = decoded;
+                } else if (status == DecodeStatus::too_large) {
+                    BOOST_LOG_TRIVIAL(warning) << "Record " << url << " discarded: " << describe(status);
+                    payload = std::string_view();
+                } else {
+                    error = std::string(describe(status)) + ": " + encoding;
+                }
             }
-            if (HTTPheader.count("content-encoding") > 0) {
-                std::string& encoding = HTTPheader["content-encoding"];
-                util::toLower(encoding);
-                decompress(payload, encoding);
-           }
-        } catch (std::invalid_argument &e) {
-           BOOST_LOG_TRIVIAL(warning) << "Cannot dechunk or decompress HTTP payload, returning raw payload: " << e.what();
         }
+        if (!error.empty())
+            BOOST_LOG_TRIVIAL(warning) << "Cannot dechunk or decompress HTTP payload, returning raw payload: " << error;
 
     }
 
@@ -171,31 +356,39 @@ namespace warc2text {
 
     }
 
-    std::string Record::readZipPayload(const std::string& content_type, const std::string& payload){
-        std::string unzipped_payload;
+    bool Record::readZipPayload(const std::string& content_type, std::string_view payload, std::string& unzipped, std::string& error) {
+        unzipped.clear();
 
         util::ZipReader zip(payload);
+        if (!zip.valid()) {
+            error = zip.error();
+            return false;
+        }
 
+        auto files = zip_types.find(content_type);
+        if (files == zip_types.end())
+            return true;
+
+        std::string file_content;
         for (auto file : zip) {
-            if (std::regex_match(file.name(), zip_types.at(content_type))) {
-                try {
-                    unzipped_payload += file.read();
-                } catch (util::ZipReadError &e) {
-                    BOOST_LOG_TRIVIAL(trace) << "Could not read file " << file.name() << " from zip archive: " << e.what();
-                }
+            if (std::regex_match(file.name(), files->second)) {
+                if (file.read(file_content, error))
+                    unzipped += file_content;
+                else
+                    BOOST_LOG_TRIVIAL(trace) << "Could not read file " << file.name() << " from zip archive: " << error;
             }
         }
 
-        return unzipped_payload;
+        return true;
     }
 
-    void Record::cleanContentType(const std::string& HTTPcontentType) {
+    void Record::cleanContentType(std::string_view HTTPcontentType) {
         // we assume the format is either "A/B; charset=C" or just "A/B"
         std::size_t delim = HTTPcontentType.find(';');
         if (delim == std::string::npos)
-            cleanHTTPcontentType = util::toLowerCopy(HTTPcontentType);
+            cleanHTTPcontentType = util::toLowerCopy(std::string(HTTPcontentType));
         else {
-            cleanHTTPcontentType = util::toLowerCopy(HTTPcontentType.substr(0, delim));
+            cleanHTTPcontentType = util::toLowerCopy(std::string(HTTPcontentType.substr(0, delim)));
             delim = HTTPcontentType.find("charset=");
             if (delim != std::string::npos) {
                 // cut until next ';' or until the end otherwise
@@ -207,6 +400,11 @@ namespace warc2text {
         util::trim(cleanHTTPcontentType);
     }
 
+    void Record::setPayload(std::string&& value) {
+        decoded = std::move(value);
+        payload = decoded;
+    }
+
     int Record::cleanPayload(bool skip_extraction){
         util::umap_tag_filters_regex tagFilters;
         return cleanPayload(tagFilters, skip_extraction);
@@ -225,8 +423,14 @@ namespace warc2text {
         if (nonTextHTTPcontentType and not bdf_zip)
             return util::NOT_VALID_RECORD;
 
-        if (bdf_zip)
-            payload = readZipPayload(content_type, payload);
+        if (bdf_zip) {
+            std::string unzipped, error;
+            if (!readZipPayload(content_type, payload, unzipped, error)) {
+                BOOST_LOG_TRIVIAL(info) << "Record " << url << " discarded due to invalid zip file: " << error;
+                return util::ZIP_READ_ERROR;
+            }
+            setPayload(std::move(unzipped));
+        }
 
         // detect charset
         std::string detected_charset;
@@ -244,11 +448,10 @@ namespace warc2text {
 
         if (skip_extraction) {
             if (needToConvert) {
-                try {
-                    payload = util::toUTF8(payload, charset);
-                } catch (boost::locale::conv::conversion_error &e) {
+                std::string converted;
+                if (!util::toUTF8(payload, charset, converted))
                     return util::UTF8_CONVERSION_ERROR;
-                }
+                setPayload(std::move(converted));
             }
             return retval;
         }
@@ -257,11 +460,10 @@ namespace warc2text {
         if (isPlainText) {
             // convert to utf8 if needed (we do it before cleaning tabs, unlike HTML below):
             if (needToConvert) {
-                try {
-                    payload = util::toUTF8(payload, charset);
-                } catch (boost::locale::conv::conversion_error &e) {
+                std::string converted;
+                if (!util::toUTF8(payload, charset, converted))
                     return util::UTF8_CONVERSION_ERROR;
-                }
+                setPayload(std::move(converted));
             }
             util::trimLinesCopy(payload, extracted);
             std::replace_if(extracted.begin(), extracted.end(), [](wchar_t c){ return std::iscntrl(c) && c != '\n'; }, ' ');
@@ -271,11 +473,10 @@ namespace warc2text {
 
             // convert to utf8 if needed:
             if (needToConvert) {
-                try {
-                    payload = util::toUTF8(extracted, charset);
-                } catch (boost::locale::conv::conversion_error &e) {
+                std::string converted;
+                if (!util::toUTF8(extracted, charset, converted))
                     return util::UTF8_CONVERSION_ERROR;
-                }
+                setPayload(std::move(converted));
             }
         }
 
@@ -288,6 +489,17 @@ namespace warc2text {
         return retval;
     }
 
+    int Record::useExtractedText() {
+        // WET text is UTF-8 by definition, so there is no charset to detect nor anything to convert,
+        // but a broken conversion record must not reach the language detector and the writers
+        cleanContentType(WARCcontentType);
+        charset = "utf-8";
+        if (!util::isValidUTF8(payload))
+            return util::UTF8_CONVERSION_ERROR;
+        plaintext = payload;
+        return util::SUCCESS;
+    }
+
     const std::unordered_map<std::string, std::string>& Record::getTextByLangs() const {
         return text_by_langs;
     }
@@ -297,30 +509,24 @@ namespace warc2text {
         return text_by_langs.size();
     }
 
-    const std::string& Record::getHeaderProperty(const std::string& property) const {
-        std::string lc_key = property;
-        util::toLower(lc_key);
-        return header.at(lc_key);
+    std::string_view Record::getHeaderProperty(std::string_view property) const {
+        const std::string_view* value = header.find(property);
+        return value ? *value : std::string_view();
     }
-    bool Record::headerExists(const std::string& property) const {
-        std::string lc_key = property;
-        util::toLower(lc_key);
-        return header.find(lc_key) != header.end();
+    bool Record::headerExists(std::string_view property) const {
+        return header.find(property) != nullptr;
     }
 
-    const std::string& Record::getHTTPheaderProperty(const std::string& property) const {
-        std::string lc_key = property;
-        util::toLower(lc_key);
-        return HTTPheader.at(lc_key);
+    std::string_view Record::getHTTPheaderProperty(std::string_view property) const {
+        const std::string_view* value = HTTPheader.find(property);
+        return value ? *value : std::string_view();
     }
 
-    bool Record::HTTPheaderExists(const std::string& property) const{
-        std::string lc_key = property;
-        util::toLower(lc_key);
-        return HTTPheader.find(lc_key) != HTTPheader.end();
+    bool Record::HTTPheaderExists(std::string_view property) const{
+        return HTTPheader.find(property) != nullptr;
     }
 
-    const std::string& Record::getPayload() const {
+    std::string_view Record::getPayload() const {
         return payload;
     }
 
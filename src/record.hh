@@ -5,23 +5,152 @@
 #ifndef WARC2TEXT_RECORD_HH
 #define WARC2TEXT_RECORD_HH
 
+#include <forward_list>
+#include <limits>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <regex>
 #include "util.hh"
 #include "lang.hh"
 
 namespace warc2text {
+    /**
+     * Fields of a WARC or HTTP header, as views into the record they were read from. The fields
+     * warc2text looks at have a fixed slot each, any other field goes into a short list in the
+     * order it was read. Names are compared regardless of case, and nothing is allocated to look
+     * a field up.
+     */
+    class HeaderTable {
+    public:
+        enum Field : unsigned char {
+            warc_type,
+            warc_target_uri,
+            warc_date,
+            warc_record_id,
+            warc_payload_digest,
+            content_type,
+            content_length,
+            content_encoding,
+            transfer_encoding,
+            status, // not a header field, the status code and reason of an HTTP response
+            n_fields,
+            other = n_fields
+        };
+
+        // slot for name, other if it does not have one
+        static Field field(std::string_view name);
+
+        void set(std::string_view name, std::string_view value);
+        void set(Field f, std::string_view value);
+        // adds a continuation line to the value of the field set last
+        void fold(std::string_view continuation);
+        void clear();
+
+        inline bool has(Field f) const {
+            return present & (1u << f);
+        }
+
+        // empty if the field is not there
+        inline std::string_view get(Field f) const {
+            return known[f];
+        }
+
+        // nullptr if the field is not there
+        const std::string_view* find(std::string_view name) const;
+
+    private:
+        static constexpr std::size_t no_field = static_cast<std::size_t>(-1);
+
+        std::string_view known[n_fields];
+        unsigned present{};
+        std::vector<std::pair<std::string_view, std::string_view>> others;
+        std::size_t last{no_field}; // slot of the field set last, n_fields + i for others[i]
+        std::forward_list<std::string> unfolded; // values of folded fields, which are not in the record as such
+    };
+
+    // position after the version line content starts with, npos if it does not start with one
+    std::size_t read_version_line(std::string_view content);
+
+    // reads the header fields from pos up to the empty line that ends them into header,
+    // returns the position after that line, npos if the header does not end
+    std::size_t read_header(std::string_view content, std::size_t pos, HeaderTable& header);
+
+    /**
+     * Just the WARC header of a record, parsed the same way Record does, so that records
+     * can be turned down before their content is read.
+     */
+    class RecordHeader {
+    public:
+        explicit RecordHeader(std::string_view content);
+
+        inline bool isValid() const {
+            return valid;
+        }
+
+        inline const std::string& getURL() const {
+            return url;
+        }
+
+        inline const std::string& getRecordType() const {
+            return recordType;
+        }
+
+        inline const std::string& getWARCcontentType() const {
+            return WARCcontentType;
+        }
+
+    private:
+        HeaderTable header;
+        std::string recordType;
+        std::string WARCcontentType;
+        std::string url;
+        bool valid{};
+    };
+
+    /**
+     * A WARC record and what is extracted from it. The record keeps the content it was built
+     * from, and its header fields and payload are views into it. The payload is only copied
+     * when it has to be rewritten: dechunked, decompressed, unzipped or converted to UTF-8.
+     * Building a record only parses its headers, so that it can be turned down before any
+     * work is done on the payload; decodePayload() has to be called before the payload is used.
+     * A record can be reset with the next content instead of being destroyed, so that its
+     * strings and tables keep the memory they grew to for the records that come after.
+     */
     class Record {
     public:
-        Record(const std::string& content, const std::string &filename, std::size_t size, std::size_t offset);
-        const std::string& getHeaderProperty(const std::string& property) const;
-        bool headerExists(const std::string& property) const;
+        Record(std::string content, const std::string &filename, std::size_t size, std::size_t offset);
+        // the views into content would not survive a copy
+        Record(const Record&) = delete;
+        Record& operator=(const Record&) = delete;
+
+        // forgets everything about the record it was and reads content instead, keeping the memory it has
+        void reset(std::string content, const std::string &filename, std::size_t size, std::size_t offset);
+
+        // undoes the transfer and content encodings of the payload, which is left as it was sent until
+        // then. A payload the server compressed is not decoded past max_size bytes, it is emptied instead.
+        void decodePayload(std::size_t max_size = std::numeric_limits<std::size_t>::max());
+
+        // empty if the field is not there
+        std::string_view getHeaderProperty(std::string_view property) const;
+        bool headerExists(std::string_view property) const;
 
-        const std::string& getHTTPheaderProperty(const std::string& property) const;
-        bool HTTPheaderExists(const std::string& property) const;
+        std::string_view getHTTPheaderProperty(std::string_view property) const;
+        bool HTTPheaderExists(std::string_view property) const;
+
+        // the whole record as it was read
+        inline const std::string& getContent() const {
+            return content;
+        }
+
+        // hands the content back so that its buffer can be reused, the record cannot be used until reset
+        inline std::string releaseContent() {
+            return std::move(content);
+        }
 
-        const std::string& getPayload() const;
+        std::string_view getPayload() const;
         const std::string& getPlainText() const;
         const std::string& getURL() const;
         const std::string& getRecordType() const;
@@ -33,7 +162,7 @@ namespace warc2text {
         bool isTextFormat() const;
 
         inline const std::string& getFilename() const {
-            return filename;
+            return *filename;
         }
 
         inline std::size_t getSize() const {
@@ -48,21 +177,26 @@ namespace warc2text {
 
         int cleanPayload(bool skip_extraction);
         int cleanPayload(const util::umap_tag_filters_regex& tagFilters, bool skip_extraction);
+        // take the payload of a conversion record (WET) as its text, it was extracted already
+        int useExtractedText();
         int detectLanguage(LanguageDetector const &detector);
 
-        static std::string readZipPayload(const std::string& content_type, const std::string& payload);
+        // the text files of a zipped document format, false if payload is not a zip archive and error says why
+        static bool readZipPayload(const std::string& content_type, std::string_view payload, std::string& unzipped, std::string& error);
         static std::string isPayloadZip(const std::string& content_type, const std::string& uri);
 
         void encodeURL();
 
     private:
-        const std::string &filename;
+        const std::string *filename;
         std::size_t size; // compressed record length in WARC
         std::size_t offset; // byte offset of start of record in WARC
 
-        std::unordered_map<std::string, std::string> header;
-        std::unordered_map<std::string, std::string> HTTPheader;
-        std::string payload;
+        std::string content;
+        HeaderTable header;
+        HeaderTable HTTPheader;
+        std::string_view payload; // into content, or into decoded once it was rewritten
+        std::string decoded;
         std::string plaintext;
         std::string language;
 
@@ -80,7 +214,9 @@ namespace warc2text {
         static const std::unordered_map<std::string, std::regex> zip_types;
         static const std::unordered_set<std::string> textContentTypes;
 
-        void cleanContentType(const std::string& HTTPcontentType);
+        void parse();
+        void cleanContentType(std::string_view HTTPcontentType);
+        void setPayload(std::string&& value);
     };
 
 } // warc2text
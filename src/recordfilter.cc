@@ -0,0 +1,52 @@
+#include "recordfilter.hh"
+#include <algorithm>
+#include <charconv>
+
+namespace warc2text {
+    void RecordFilterChain::add(std::string name, unsigned cost, Check check) {
+        auto filter = std::make_unique<Filter>();
+        filter->name = std::move(name);
+        filter->cost = cost;
+        filter->check = std::move(check);
+        // after the checks that cost the same, so equal ones run in the order they were added
+        auto position = std::upper_bound(filters.begin(), filters.end(), cost,
+            [](unsigned cost, const std::unique_ptr<Filter>& other) { return cost < other->cost; });
+        filters.insert(position, std::move(filter));
+    }
+
+    bool RecordFilterChain::accept(const Record& record) const {
+        for (const auto& filter : filters) {
+            if (!filter->check(record)) {
+                filter->rejected.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<std::pair<std::string, std::size_t>> RecordFilterChain::rejections() const {
+        std::vector<std::pair<std::string, std::size_t>> counts;
+        for (const auto& filter : filters)
+            counts.emplace_back(filter->name, filter->rejected.load(std::memory_order_relaxed));
+        return counts;
+    }
+
+    bool hasExtension(std::string_view url, const std::unordered_set<std::string>& extensions) {
+        std::size_t dot = url.rfind('.');
+        // a dot before the last slash belongs to the host or a directory
+        if (dot == std::string_view::npos || url.find('/', dot) != std::string_view::npos)
+            return false;
+        return extensions.count(std::string(url.substr(dot))) > 0;
+    }
+
+    int statusCode(std::string_view status) {
+        // from_chars would take a minus sign
+        if (status.size() < 3 || status[0] < '0' || status[0] > '9')
+            return 0;
+        int code = 0;
+        auto result = std::from_chars(status.data(), status.data() + 3, code);
+        if (result.ec != std::errc() || result.ptr != status.data() + 3)
+            return 0;
+        return code;
+    }
+}
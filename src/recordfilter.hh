@@ -0,0 +1,50 @@
+#ifndef WARC2TEXT_RECORDFILTER_HH
+#define WARC2TEXT_RECORDFILTER_HH
+
+#include "record.hh"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace warc2text {
+    /**
+     * Checks that turn records down on what their WARC and HTTP headers say, so that nothing
+     * is done with the payload of a record that would be thrown away anyway. The chain is put
+     * together once and runs its checks cheapest first; the first check a record fails rejects
+     * it and is counted. Checks can run from several threads at the same time.
+     */
+    class RecordFilterChain {
+        public:
+            using Check = std::function<bool(const Record&)>;
+
+            // check returns true for the records to keep, cost is its rough price relative to the others
+            void add(std::string name, unsigned cost, Check check);
+            // true if record passes every check
+            bool accept(const Record& record) const;
+            // name of every check and how many records it rejected, in the order they run
+            std::vector<std::pair<std::string, std::size_t>> rejections() const;
+
+        private:
+            struct Filter {
+                std::string name;
+                unsigned cost;
+                Check check;
+                mutable std::atomic<std::size_t> rejected{0};
+            };
+            std::vector<std::unique_ptr<Filter>> filters; // sorted by cost
+    };
+
+    // true if the path of url ends in one of extensions, each of which starts with its only dot
+    bool hasExtension(std::string_view url, const std::unordered_set<std::string>& extensions);
+
+    // HTTP status code at the start of status, 0 if it does not start with one
+    int statusCode(std::string_view status);
+}
+
+#endif
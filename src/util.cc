@@ -2,6 +2,9 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/trim_all.hpp>
@@ -10,9 +13,9 @@
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/classification.hpp>
-#include <boost/locale.hpp>
 #include <boost/log/trivial.hpp>
 #include <uchardet/uchardet.h>
+#include <iconv.h>
 #include "preprocess/base64.hh"
 
 namespace util {
@@ -27,13 +30,20 @@ namespace util {
         boost::algorithm::trim(s);
     }
 
+    void trim(std::string_view& s){
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+            s.remove_prefix(1);
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+            s.remove_suffix(1);
+    }
+
     // TODO: right now this leaves a single space at the beginning and the end of the line
     void trimLines(std::string& text) {
         std::string::iterator new_end = std::unique(text.begin(), text.end(), [](char lhs, char rhs){return (lhs == '\n' && rhs == '\n') || (std::isspace(lhs) && rhs != '\n' && std::isspace(rhs));});
         text.erase(new_end, text.end());
     }
 
-    void trimLinesCopy(const std::string& original, std::string& result){
+    void trimLinesCopy(std::string_view original, std::string& result){
         result.clear();
         result.reserve(original.size()); // Worst case
 
@@ -65,9 +75,9 @@ namespace util {
         }
     }
 
-    bool detectCharset(const std::string& text, std::string& charset, const std::string& original_charset){
+    bool detectCharset(std::string_view text, std::string& charset, const std::string& original_charset){
         uchardet_t handle = uchardet_new();
-        int chardet_result = uchardet_handle_data(handle, text.c_str(), text.size());
+        int chardet_result = uchardet_handle_data(handle, text.data(), text.size());
         uchardet_data_end(handle);
         bool success = (chardet_result == 0);
         // trust the detected more than the specified charset
@@ -81,25 +91,111 @@ namespace util {
         uchardet_delete(handle);
         if (charset.empty()) return false;
 
-        // check that boost can work with the detected charset
-        try {
-            boost::locale::conv::to_utf<char>("", charset);
-        } catch (const boost::locale::conv::invalid_charset_error& e) {
+        // check that it can be converted from
+        iconv_t converter = iconv_open("UTF-8", charset.c_str());
+        if (converter == reinterpret_cast<iconv_t>(-1))
             return false;
-        }
+        iconv_close(converter);
         return true;
     }
 
-    std::string toUTF8(const std::string& text, const std::string& charset) {
-        return boost::locale::conv::to_utf<char>(text, charset, boost::locale::conv::stop);
+    bool toUTF8(std::string_view text, const std::string& charset, std::string& out) {
+        iconv_t converter = iconv_open("UTF-8", charset.c_str());
+        if (converter == reinterpret_cast<iconv_t>(-1))
+            return false;
+
+        // most text takes about as many bytes in UTF-8, grow if it does not
+        out.resize(text.size() + text.size() / 2 + 16);
+        char* in = const_cast<char*>(text.data());
+        std::size_t in_left = text.size();
+        std::size_t produced = 0;
+        bool ok = true;
+        bool unshifting = false;
+        while (true) {
+            char* out_ptr = &out[produced];
+            std::size_t out_left = out.size() - produced;
+            // with no input left, write what the converter still holds back
+            std::size_t result = unshifting ? iconv(converter, nullptr, nullptr, &out_ptr, &out_left)
+                                            : iconv(converter, &in, &in_left, &out_ptr, &out_left);
+            produced = out_ptr - out.data();
+            if (result == static_cast<std::size_t>(-1)) {
+                if (errno == E2BIG) {
+                    out.resize(out.size() * 2);
+                    continue;
+                }
+                // invalid or incomplete sequence
+                ok = false;
+                break;
+            }
+            // characters that could not be converted exactly
+            if (result != 0) {
+                ok = false;
+                break;
+            }
+            if (unshifting)
+                break;
+            unshifting = true;
+        }
+        iconv_close(converter);
+        out.resize(produced);
+        return ok;
     }
-    std::string toUTF8(const char* text, const std::string& charset) {
-        return boost::locale::conv::to_utf<char>(text, charset, boost::locale::conv::stop);
+
+    bool isValidUTF8(std::string_view text) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+        const unsigned char* end = p + text.size();
+        while (p < end) {
+            // skip ASCII eight bytes at a time
+            uint64_t block;
+            if (end - p >= 8 && (std::memcpy(&block, p, 8), (block & 0x8080808080808080ull) == 0)) {
+                p += 8;
+                continue;
+            }
+            if (*p < 0x80) {
+                ++p;
+                continue;
+            }
+            // length of the sequence and range of its second byte, which rules out overlong
+            // forms, surrogates and code points past U+10FFFF
+            std::ptrdiff_t length;
+            unsigned char low = 0x80, high = 0xBF;
+            if (*p >= 0xC2 && *p <= 0xDF) {
+                length = 2;
+            } else if (*p >= 0xE0 && *p <= 0xEF) {
+                length = 3;
+                if (*p == 0xE0) low = 0xA0;
+                else if (*p == 0xED) high = 0x9F;
+            } else if (*p >= 0xF0 && *p <= 0xF4) {
+                length = 4;
+                if (*p == 0xF0) low = 0x90;
+                else if (*p == 0xF4) high = 0x8F;
+            } else {
+                return false;
+            }
+            if (end - p < length || p[1] < low || p[1] > high)
+                return false;
+            for (std::ptrdiff_t i = 2; i < length; ++i)
+                if ((p[i] & 0xC0) != 0x80)
+                    return false;
+            p += length;
+        }
+        return true;
+    }
+
+    std::size_t findHeaderEnd(std::string_view text, std::size_t pos) {
+        // an empty line is a line end right after another one
+        for (pos = text.find('\n', pos); pos != std::string_view::npos; pos = text.find('\n', pos + 1)) {
+            if (text.compare(pos + 1, 1, "\n") == 0)
+                return pos + 2;
+            if (text.compare(pos + 1, 2, "\r\n") == 0)
+                return pos + 3;
+        }
+        return std::string_view::npos;
     }
 
-    std::string encodeBase64(const std::string &original) {
+    std::string encodeBase64(std::string_view original) {
         std::string out;
-        preprocess::base64_encode(original, out);
+        preprocess::base64_encode({original.data(), original.size()}, out);
         return out;
     }
 
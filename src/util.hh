@@ -2,6 +2,7 @@
 #define WARC2TEXT_UTIL_HH
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -15,18 +16,24 @@ namespace util {
 
     // trim consecutive spaces from left and right
     void trim(std::string& s);
+    void trim(std::string_view& s);
 
     // trim consecutive spaces but respect newlines:
     void trimLines(std::string& text);
-    void trimLinesCopy(const std::string& original, std::string& result);
+    void trimLinesCopy(std::string_view original, std::string& result);
 
     // detect charset using uchardet
-    bool detectCharset(const std::string& text, std::string& charset, const std::string& original_charset = "");
-    // convert to utf8
-    std::string toUTF8 (const std::string& text, const std::string& charset);
-    std::string toUTF8 (const char* text, const std::string& charset);
+    bool detectCharset(std::string_view text, std::string& charset, const std::string& original_charset = "");
+    // convert to utf8 into out, false if text is not valid in charset or charset is not known
+    bool toUTF8(std::string_view text, const std::string& charset, std::string& out);
+    // whether text is well formed UTF-8
+    bool isValidUTF8(std::string_view text);
 
-    std::string encodeBase64(const std::string& original);
+    // position after the empty line that ends a WARC or HTTP header, looking from pos on, npos if
+    // there is none yet. Lines end in CRLF or a bare LF, so both "\r\n\r\n" and "\n\n" end it.
+    std::size_t findHeaderEnd(std::string_view text, std::size_t pos = 0);
+
+    std::string encodeBase64(std::string_view original);
 
     const std::string reserved_chars_url("!#$&'()*+,/:;=?[]");
     std::string encodeURLs(const std::string& url);
@@ -37,7 +44,8 @@ namespace util {
         FILTERED_DOCUMENT_ERROR = 2,
         UNKNOWN_ENCODING_ERROR = 3,
         UTF8_CONVERSION_ERROR = 4,
-        NOT_VALID_RECORD = 5
+        NOT_VALID_RECORD = 5,
+        ZIP_READ_ERROR = 6
     };
 
     inline bool uset_contains(const std::unordered_set<std::string>& uset, const std::string& value) {
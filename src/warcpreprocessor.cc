@@ -4,17 +4,24 @@
 #include "warcpreprocessor.hh"
 #include "src/lang.hh"
 #include "zipreader.hh"
+#include "parallelreader.hh"
+#include "queue.hh"
 #include "util/compress.hh"
-#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <thread>
 #include <boost/log/trivial.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
 
 namespace {
     const std::string kRobotsTxtPath = "/robots.txt";
-    using json = nlohmann::json;
 
-    bool isRobotsTxt(const warc2text::Record &record) {
-        const auto &url = record.getURL();
+    bool isRobotsTxt(const std::string &url) {
 
         // Find the bit after https://
         auto host_offset = url.find("://");
@@ -72,14 +79,10 @@ namespace warc2text {
         writer(writer),
         detector(detector),
         options(options),
-        totalRecords(0),
-        textRecords(0),
-        langRecords(0),
-        totalBytes(0),
-        textBytes(0),
-        langBytes(0),
+        stats(),
         tagFilters(),
-        statusFilter("^20[036] ?.*$")
+        started(std::chrono::steady_clock::now()),
+        last_checkpoint(started)
     {
             if (!options.tag_filters_filename.empty())
                 util::readTagFiltersRegex(options.tag_filters_filename, tagFilters);
@@ -87,43 +90,258 @@ namespace warc2text {
             if (!options.url_filters_filename.empty())
                 util::readUrlFiltersRegex(options.url_filters_filename, urlFilter);
 
+            buildFilters();
+
+            if (!options.checkpoint_filename.empty() && resumed.load(options.checkpoint_filename)) {
+                BOOST_LOG_TRIVIAL(info) << "Carrying on from checkpoint " << options.checkpoint_filename;
+                // throw away whatever was written after the checkpoint
+                for (const auto& output : resumed.outputs) {
+                    boost::system::error_code ec;
+                    boost::filesystem::resize_file(output.first, output.second, ec);
+                    if (ec)
+                        BOOST_LOG_TRIVIAL(warning) << "Checkpoint " << options.checkpoint_filename << ": could not cut " << output.first << " back to " << output.second << " bytes";
+                }
+                writer.resume(resumed.outputs);
+                ledger = resumed;
+            }
+
             if (!options.pdf_warc_filename.empty())
-                pdf_warc_writer.open(options.pdf_warc_filename);
+                pdf_warc_writer.open(options.pdf_warc_filename, resumed.outputs.count(WARCWriter::outputName(options.pdf_warc_filename)));
 
             if (!options.robots_warc_filename.empty())
-                robots_warc_writer.open(options.robots_warc_filename);
+                robots_warc_writer.open(options.robots_warc_filename, resumed.outputs.count(WARCWriter::outputName(options.robots_warc_filename)));
+
+            if (!options.cdx_filename.empty())
+                readCDX(options.cdx_filename, options.cdx_prefix, index);
+
+            if (!options.cdxj_filename.empty())
+                cdxj_writer.open(options.cdxj_filename, options.cdxj_sorted, resumed.outputs.count(options.cdxj_filename));
         }
 
-    // true if url is good
-    bool WARCPreprocessor::URLfilter(const std::string& url) const {
-        for (const std::string& ext : removeExtensions)
-            if (boost::algorithm::ends_with(url, ext))
+    // checks that cost the same run in the order they are added here
+    void WARCPreprocessor::buildFilters() {
+        recordFilters.add("record type", 1, [](const Record& record) {
+            return record.getRecordType() == "response" || record.getRecordType() == "resource";
+        });
+        recordFilters.add("WARC content type", 2, [](const Record& record) {
+            return record.getWARCcontentType().find("application/http") != std::string::npos;
+        });
+        // 200 OK, 203 Non-Authoritative Information and 206 Partial Content
+        recordFilters.add("HTTP status", 2, [](const Record& record) {
+            if (!record.HTTPheaderExists("status"))
+                return true;
+            int code = statusCode(record.getHTTPheaderProperty("status"));
+            return code == 200 || code == 203 || code == 206;
+        });
+
+        if (!options.start_date.empty() || !options.end_date.empty()) {
+            textFilters.add("WARC date", 1, [this](const Record& record) {
+                const std::string& date = record.getWARCdate();
+                return !date.empty() && date >= options.start_date
+                    && (options.end_date.empty() || date < options.end_date);
+            });
+        }
+        textFilters.add("URL extension", 2, [](const Record& record) {
+            return !hasExtension(record.getURL(), removeExtensions);
+        });
+        // neither text nor a document format that text can be taken out of
+        textFilters.add("HTTP content type", 3, [](const Record& record) {
+            return record.getHTTPcontentType().empty() || record.isTextFormat()
+                || !Record::isPayloadZip(record.getHTTPcontentType(), record.getURL()).empty();
+        });
+        if (!urlFilter.empty()) {
+            textFilters.add("URL filter", 10, [this](const Record& record) {
+                if (!boost::regex_search(record.getURL(), urlFilter))
+                    return true;
+                BOOST_LOG_TRIVIAL(info) << "Url filter matched '" << record.getURL() << "'";
                 return false;
+            });
+        }
+    }
+
+    // false if processRecord would throw the record away based on its WARC header alone
+    bool WARCPreprocessor::headerFilter(std::string_view content) const {
+        RecordHeader header(content);
+        // leave it to Record to complain about
+        if (!header.isValid())
+            return true;
+
+        if (!options.robots_process && ::isRobotsTxt(header.getURL()))
+            return robots_warc_writer.is_open();
 
-        if (!urlFilter.empty() && boost::regex_search(url, urlFilter)) {
-            BOOST_LOG_TRIVIAL(info) << "Url filter matched '" << url << "'";
+        if (options.wet && header.getRecordType() == "conversion")
+            return header.getWARCcontentType().find("text/plain") != std::string::npos;
+
+        if (header.getRecordType() != "response" && header.getRecordType() != "resource")
             return false;
-        }
-        
+
+        if (header.getWARCcontentType().find("application/http") == std::string::npos)
+            return false;
+
+        // PDFs go to their own WARC whatever their URL looks like
+        if (!pdf_warc_writer.is_open() && hasExtension(header.getURL(), removeExtensions))
+            return false;
+
         return true;
     }
 
+    RecordStatistics& RecordStatistics::operator+=(const RecordStatistics& other) {
+        totalRecords += other.totalRecords;
+        textRecords += other.textRecords;
+        langRecords += other.langRecords;
+        totalBytes += other.totalBytes;
+        textBytes += other.textBytes;
+        langBytes += other.langBytes;
+        return *this;
+    }
+
     void WARCPreprocessor::process(const std::string& filename) {
+        if (options.threads > 1) {
+            if (!processParallel({filename}))
+                throw WARCFileException();
+            return;
+        }
+
         std::string record_filename;
         if(filename.empty())
             record_filename = "stdin";
         else
             record_filename = filename;
         BOOST_LOG_TRIVIAL(info) << "Processing " << record_filename;
-        WARCReader reader(filename);
+        std::unique_ptr<RecordReader> reader = openReader(filename);
+        try {
+            if (processSerial(*reader, record_filename))
+                updateLedger(record_filename, reader->tell(), true);
+        } catch (const WARCFileException &e) {
+            addSkipStatistics(*reader);
+            throw;
+        }
+        addSkipStatistics(*reader);
+    }
+
+    void WARCPreprocessor::addSkipStatistics(const RecordReader& reader) {
+        std::lock_guard<std::mutex> lock(skipped_mutex);
+        skipped += reader.getSkipStatistics();
+    }
+
+    std::unique_ptr<RecordReader> WARCPreprocessor::openReader(const std::string& filename) const {
+        // skip records processRecord would throw away as soon as their header is read,
+        // unless all of them need to go in the CDXJ index
+        HeaderFilter filter;
+        if (options.cdxj_filename.empty())
+            filter = [this](std::string_view header) { return headerFilter(header); };
+
+        auto indexed = index.find(filename);
+        if (indexed != index.end()) {
+            // seeking around does not go with reading ahead
+            auto reader = std::make_unique<WARCReader>(filename, options.read_size, options.mmap_input, 0, options.inflate_engine);
+            reader->setHeaderFilter(filter);
+            return std::make_unique<IndexedWARCReader>(std::move(reader), filename, indexed->second);
+        }
+
+        std::unique_ptr<RecordReader> reader;
+        // speculative parallel inflating only works for gzip members
+        bool parallel = options.inflate_threads > 0 && !boost::algorithm::ends_with(filename, ".zst") && !boost::algorithm::ends_with(filename, ".warc");
+        // carry on after the last record written by the run that stopped
+        std::size_t start_offset = std::max(options.start_offset, resumed.resumeOffset(filename));
+        bool ranged = start_offset > 0 || options.end_offset < std::numeric_limits<size_t>::max();
+        if (parallel) {
+            auto parallel_reader = std::make_unique<ParallelWARCReader>(filename, options.inflate_threads, options.max_record_size);
+            if (ranged)
+                parallel_reader->setRange(start_offset, options.end_offset);
+            reader = std::move(parallel_reader);
+        } else {
+            auto warc_reader = std::make_unique<WARCReader>(filename, options.read_size, options.mmap_input, options.read_ahead, options.inflate_engine);
+            if (ranged)
+                warc_reader->setRange(start_offset, options.end_offset);
+            reader = std::move(warc_reader);
+        }
+        reader->setHeaderFilter(filter);
+        reader->setRecover(options.recover);
+        if (!parallel && options.inflate_ahead > 0)
+            return std::make_unique<ReadAheadWARCReader>(std::move(reader), options.inflate_ahead, options.max_record_size);
+        return reader;
+    }
+
+    std::vector<std::string> WARCPreprocessor::getIndexedFiles() const {
+        std::vector<std::string> filenames;
+        for (const auto& indexed : index)
+            filenames.push_back(indexed.first);
+        return filenames;
+    }
+
+    bool WARCPreprocessor::process(const std::vector<std::string>& all_filenames) {
+        std::vector<std::string> filenames;
+        for (const std::string& filename : all_filenames) {
+            if (resumed.isDone(filename))
+                BOOST_LOG_TRIVIAL(info) << "Skipping " << filename << ", it was done before the checkpoint";
+            else
+                filenames.push_back(filename);
+        }
+
+        bool success = true;
+        if (options.threads > 1 || options.parallel_files > 1) {
+            success = processParallel(filenames);
+        } else {
+            for (const std::string& filename : filenames) {
+                if (stopped_early)
+                    break;
+                try {
+                    process(filename);
+                } catch (const WARCFileException &e) {
+                    success = false;
+                }
+            }
+        }
+
+        if (!options.checkpoint_filename.empty())
+            checkpoint();
+        if (stopped_early)
+            BOOST_LOG_TRIVIAL(info) << "Stopped at the deadline, run again to carry on from the checkpoint";
+        return success;
+    }
+
+    bool WARCPreprocessor::pastDeadline() const {
+        return options.deadline > 0 && std::chrono::steady_clock::now() - started >= std::chrono::seconds(options.deadline);
+    }
+
+    bool WARCPreprocessor::stoppedEarly() const {
+        return stopped_early;
+    }
+
+    void WARCPreprocessor::updateLedger(const std::string& input, std::size_t offset, bool done) {
+        if (options.checkpoint_filename.empty())
+            return;
+        InputProgress& progress = ledger.inputs[input];
+        progress.offset = offset;
+        progress.done = done;
+        if (std::chrono::steady_clock::now() - last_checkpoint >= std::chrono::seconds(options.checkpoint_interval))
+            checkpoint();
+    }
+
+    void WARCPreprocessor::checkpoint() {
+        // outputs of the previous run this one has not opened yet keep their size
+        writer.checkpoint(ledger.outputs);
+        pdf_warc_writer.checkpoint(ledger.outputs);
+        robots_warc_writer.checkpoint(ledger.outputs);
+        cdxj_writer.checkpoint(ledger.outputs);
+        ledger.save(options.checkpoint_filename);
+        last_checkpoint = std::chrono::steady_clock::now();
+        BOOST_LOG_TRIVIAL(debug) << "Checkpoint " << options.checkpoint_filename << " saved";
+    }
 
+    bool WARCPreprocessor::processSerial(RecordReader& reader, const std::string& filename) {
         std::string content;
-        int n_langs = 0;
+        std::unique_ptr<Record> spare;
 
         while (true) {
-            std::size_t offset = reader.tell();
-            std::size_t size = reader.getRecord(content, options.max_record_size);
-            
+            if (pastDeadline()) {
+                stopped_early = true;
+                return false;
+            }
+            std::size_t offset;
+            std::size_t size = reader.nextRecord(content, offset, options.max_record_size);
+
             // No more records (EOF or failure to inflate)
             if (size == 0)
                 break;
@@ -132,136 +350,328 @@ namespace warc2text {
             if (content.empty())
                 continue;
 
-            Record record(content, record_filename, size, offset);
-            if (record.getPayload().empty())
-                continue;
+            ProcessedRecord result = processRecord(std::move(content), filename, size, offset, std::move(spare));
+            commit(result);
+            // read the next record into the same buffer
+            content = result.record->releaseContent();
+            if (options.reuse_records)
+                spare = std::move(result.record);
+        }
+        return true;
+    }
 
-            // Pick out all robots.txt related records.
-            if (!options.robots_process && ::isRobotsTxt(record)) {
-                robots_warc_writer.writeRecord(content); // no-op if robots_warc_writer is not opened.
-                continue;
+    bool WARCPreprocessor::processParallel(const std::vector<std::string>& filenames) {
+        // reader threads -> worker threads -> this thread (writer).
+        // Every record read gets a future in `pending` before its task is queued, so the
+        // writer commits the records of each file in exactly the order they appear in it.
+        using Task = std::packaged_task<ProcessedRecord()>;
+        const unsigned n_readers = std::max(1u, std::min<unsigned>(options.parallel_files, filenames.size()));
+        const unsigned n_workers = std::max(1u, options.threads);
+        const std::size_t queue_size = std::max(n_readers, n_workers) * 4;
+        util::BoundedQueue<Task> tasks(queue_size);
+        util::BoundedQueue<std::future<ProcessedRecord>> pending(queue_size);
+        // records the writer is done with, on their way back to the readers
+        util::Pool<Record> records(options.reuse_records ? queue_size * 2 : 0);
+
+        // Name used for each input in the output, and the order in which readers pick
+        // them up. With several readers that is largest first, so that a big file started
+        // late does not become the long tail of the run while the other readers sit idle.
+        // With a single reader keep the command line order, so output matches a serial run.
+        std::vector<std::string> labels;
+        std::vector<std::uintmax_t> sizes;
+        for (const std::string& filename : filenames) {
+            labels.push_back(filename.empty() ? "stdin" : filename);
+            boost::system::error_code ec;
+            std::uintmax_t size = filename.empty() || filename == "-" ? 0 : boost::filesystem::file_size(filename, ec);
+            // stdin and anything we cannot stat goes first, it won't get any smaller
+            sizes.push_back(filename.empty() || filename == "-" || ec ? std::numeric_limits<std::uintmax_t>::max() : size);
+        }
+        std::vector<std::size_t> order(filenames.size());
+        std::iota(order.begin(), order.end(), 0);
+        if (n_readers > 1)
+            std::stable_sort(order.begin(), order.end(), [&sizes](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < n_workers; ++i) {
+            workers.emplace_back([&tasks]{
+                // an empty task marks the end of the input
+                for (Task task = tasks.pop(); task.valid(); task = tasks.pop())
+                    task();
+            });
+        }
+
+        std::atomic<std::size_t> next_file{0};
+        std::atomic<unsigned> active_readers{n_readers};
+        std::atomic<bool> stop{false};
+        std::atomic<bool> file_error{false};
+        std::mutex read_error_mutex;
+        std::exception_ptr read_error;
+
+        auto read = [&]{
+            try {
+                std::string content;
+                for (std::size_t i = next_file++; i < order.size() && !stop; i = next_file++) {
+                    const std::string& filename = filenames[order[i]];
+                    const std::string& label = labels[order[i]];
+                    BOOST_LOG_TRIVIAL(info) << "Processing " << label;
+                    std::unique_ptr<RecordReader> reader;
+                    try {
+                        reader = openReader(filename);
+                        bool finished = false;
+                        std::unique_ptr<Record> recycled;
+                        while (!stop) {
+                            if (pastDeadline()) {
+                                stopped_early = true;
+                                stop = true;
+                                break;
+                            }
+                            // read into the buffer of a record the writer is done with
+                            if (options.reuse_records && !recycled && (recycled = records.take()))
+                                content = recycled->releaseContent();
+                            std::size_t offset;
+                            std::size_t size = reader->nextRecord(content, offset, options.max_record_size);
+                            if (size == 0) {
+                                finished = true;
+                                break;
+                            }
+                            if (content.empty())
+                                continue;
+                            Task task([this, content = std::move(content), recycled = std::move(recycled), &label, size, offset]() mutable {
+                                return processRecord(std::move(content), label, size, offset, std::move(recycled));
+                            });
+                            pending.push(task.get_future());
+                            tasks.push(std::move(task));
+                        }
+                        if (finished && !options.checkpoint_filename.empty()) {
+                            // goes to the writer behind all the records of the input
+                            std::promise<ProcessedRecord> end;
+                            ProcessedRecord result;
+                            result.finished_input = label;
+                            end.set_value(std::move(result));
+                            pending.push(end.get_future());
+                        }
+                    } catch (const WARCFileException &e) {
+                        // already logged by the reader, carry on with the next file
+                        file_error = true;
+                    }
+                    if (reader)
+                        addSkipStatistics(*reader);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(read_error_mutex);
+                if (!read_error)
+                    read_error = std::current_exception();
+                stop = true;
             }
+            // the last reader out tells the writer and the workers that there is nothing else to wait for
+            if (--active_readers == 0) {
+                pending.push(std::future<ProcessedRecord>());
+                for (unsigned i = 0; i < n_workers; ++i)
+                    tasks.push(Task());
+            }
+        };
 
-            if (record.getRecordType() != "response" && record.getRecordType() != "resource")
-                continue;
+        std::vector<std::thread> readers;
+        for (unsigned i = 0; i < n_readers; ++i)
+            readers.emplace_back(read);
 
-            if (record.HTTPheaderExists("status") && !boost::regex_match(record.getHTTPheaderProperty("status"), statusFilter)) {
+        std::exception_ptr write_error;
+        for (auto result = pending.pop(); result.valid(); result = pending.pop()) {
+            // keep draining after an error so the readers and workers can finish
+            if (write_error)
                 continue;
+            try {
+                ProcessedRecord processed = result.get();
+                commit(processed);
+                if (options.reuse_records && processed.record)
+                    records.give(std::move(processed.record));
+            } catch (...) {
+                write_error = std::current_exception();
+                stop = true;
             }
+        }
 
-            if (record.getWARCcontentType().find("application/http") == std::string::npos)
-                continue;
+        for (std::thread& reader : readers)
+            reader.join();
+        for (std::thread& worker : workers)
+            worker.join();
 
-            if (::isPDF(record)) {
-                // found a PDF file, write record to disk and continue
-                // this is a no-op if pdf_warc_writer is not opened.
-                pdf_warc_writer.writeRecord(content);
-                continue;
+        if (write_error)
+            std::rethrow_exception(write_error);
+        if (read_error)
+            std::rethrow_exception(read_error);
+        return !file_error;
+    }
+
+    ProcessedRecord WARCPreprocessor::processRecord(std::string content, const std::string& filename, std::size_t size, std::size_t offset, std::unique_ptr<Record> recycled) const {
+        ProcessedRecord result;
+
+        if (recycled) {
+            recycled->reset(std::move(content), filename, size, offset);
+            result.record = std::move(recycled);
+        } else {
+            result.record = std::make_unique<Record>(std::move(content), filename, size, offset);
+        }
+        Record* record = result.record.get();
+        if (record->getPayload().empty())
+            return result;
+
+        // Pick out all robots.txt related records.
+        if (!options.robots_process && ::isRobotsTxt(record->getURL())) {
+            if (robots_warc_writer.is_open())
+                result.action = ProcessedRecord::Action::robots;
+            return result;
+        }
+
+        // conversion records carry text only, none of the HTTP, charset or HTML stages apply to them
+        bool extracted = options.wet && record->getRecordType() == "conversion";
+        if (extracted) {
+            if (record->getWARCcontentType().find("text/plain") == std::string::npos)
+                return result;
+        } else {
+            if (!recordFilters.accept(*record))
+                return result;
+
+            if (::isPDF(*record)) {
+                // found a PDF file, pass the record on so it gets written to the PDF WARC
+                if (pdf_warc_writer.is_open())
+                    result.action = ProcessedRecord::Action::pdf;
+                return result;
             }
+        }
 
-            if (record.getPayload().size() > 5242880) // 5MB
-                continue;
+        if (!textFilters.accept(*record))
+            return result;
 
-            if (!URLfilter(record.getURL()))
-                continue;
+        // only now that it is known to be wanted
+        record->decodePayload(options.max_record_size);
+        if (record->getPayload().empty() || record->getPayload().size() > 5242880) // 5MB
+            return result;
 
-            if (options.encodeURLs)
-                record.encodeURL();
+        if (options.encodeURLs)
+            record->encodeURL();
 
-            BOOST_LOG_TRIVIAL(trace) << "Processing HTML document " << record.getURL() << "\n";
+        BOOST_LOG_TRIVIAL(trace) << "Processing HTML document " << record->getURL() << "\n";
 
-            ++totalRecords;
-            totalBytes += record.getPayload().size();
+        RecordStatistics& stats = result.stats;
+        ++stats.totalRecords;
+        stats.totalBytes += record->getPayload().size();
 
-            int clean_retval;
-            try{
-                clean_retval = record.cleanPayload(tagFilters, options.skip_text_extraction);
-            }
-            catch (std::out_of_range& e) { continue; }
-            catch (std::invalid_argument& e) { continue; }
-            catch (util::ZipReadError& e) {
-                BOOST_LOG_TRIVIAL(info) << "Record " << record.getURL() << " discarded due to invalid zip file: " << e.what();
-                continue;
-            }
+        int clean_retval;
+        if (extracted)
+            clean_retval = record->useExtractedText();
+        else
+            clean_retval = record->cleanPayload(tagFilters, options.skip_text_extraction);
+
+        if ((clean_retval == util::FILTERED_DOCUMENT_ERROR) != options.tag_filters_invert) {
+            BOOST_LOG_TRIVIAL(info) << "Record " << record->getURL() << " discarded due to tag filters";
+            return result;
+        } else if (clean_retval == util::HTML_PARSING_ERROR) {
+            BOOST_LOG_TRIVIAL(trace) << "Record " << record->getURL() << ": parsing error";
+            return result;
+        } else if (clean_retval == util::UNKNOWN_ENCODING_ERROR) {
+            BOOST_LOG_TRIVIAL(trace) << "Record " << record->getURL() << ": unknown encoding";
+            return result;
+        } else if (clean_retval == util::UTF8_CONVERSION_ERROR) {
+            BOOST_LOG_TRIVIAL(trace) << "Record " << record->getURL() << ": utf8 conversion error";
+            return result;
+        } else if (clean_retval == util::NOT_VALID_RECORD) {
+            BOOST_LOG_TRIVIAL(trace) << "Record " << record->getURL() << ": WARC or HTTP header content type not valid";
+            return result;
+        } else if (clean_retval == util::ZIP_READ_ERROR) {
+            return result;
+        }
 
-            if ((clean_retval == util::FILTERED_DOCUMENT_ERROR) != options.tag_filters_invert) {
-                BOOST_LOG_TRIVIAL(info) << "Record " << record.getURL() << " discarded due to tag filters";
-                continue;
-            } else if (clean_retval == util::HTML_PARSING_ERROR) {
-                BOOST_LOG_TRIVIAL(trace) << "Record " << record.getURL() << ": parsing error";
-                continue;
-            } else if (clean_retval == util::UNKNOWN_ENCODING_ERROR) {
-                BOOST_LOG_TRIVIAL(trace) << "Record " << record.getURL() << ": unknown encoding";
-                continue;
-            } else if (clean_retval == util::UTF8_CONVERSION_ERROR) {
-                BOOST_LOG_TRIVIAL(trace) << "Record " << record.getURL() << ": utf8 conversion error";
-                continue;
-            } else if (clean_retval == util::NOT_VALID_RECORD) {
-                BOOST_LOG_TRIVIAL(trace) << "Record " << record.getURL() << ": WARC or HTTP header content type not valid";
-                continue;
-            }
+        if (record->getPlainText().empty() && !options.skip_text_extraction) {
+            BOOST_LOG_TRIVIAL(trace) << "Record " << record->getURL() << ": empty";
+            return result;
+        }
+
+        ++stats.textRecords;
+        // When skipping text extraction sum payload bytes because text is empty
+        if (options.skip_text_extraction)
+            stats.textBytes += record->getPayload().size();
+        else
+            stats.textBytes += record->getPlainText().size();
 
-            if (record.getPlainText().empty() && !options.skip_text_extraction) {
-                BOOST_LOG_TRIVIAL(trace) << "Record " << record.getURL() << ": empty";
+        record->detectLanguage(detector);
+        int n_langs = 0;
+        for (auto const &chunk : record->getTextByLangs()) {
+            // Don't count the unknown language chunks
+            if (chunk.first == LanguageDetector::kUnknownLanguageLabel)
                 continue;
-            }
 
-            ++textRecords;
-            // When skipping text extraction sum payload bytes because text is empty
-            if (options.skip_text_extraction)
-                textBytes += record.getPayload().size();
-            else
-                textBytes += record.getPlainText().size();
-
-            record.detectLanguage(detector);
-            n_langs = 0;
-            for (auto const &chunk : record.getTextByLangs()) {
-                // Don't count the unknown language chunks
-                if (chunk.first == LanguageDetector::kUnknownLanguageLabel)
-                    continue;
-                
-                langBytes += chunk.second.size();
-                ++n_langs;
-            }
+            stats.langBytes += chunk.second.size();
+            ++n_langs;
+        }
 
-            if (n_langs > 1) {
-                BOOST_LOG_TRIVIAL(trace) << "Record " << record.getURL() << ": multiple (" << n_langs << ") languages detected";
-            } else if (n_langs == 1) {
+        if (n_langs > 1) {
+            BOOST_LOG_TRIVIAL(trace) << "Record " << record->getURL() << ": multiple (" << n_langs << ") languages detected";
+        } else if (n_langs == 1) {
 
-            } else {
-                BOOST_LOG_TRIVIAL(trace) << "Record " << record.getURL() << ": language not detected";
-            }
+        } else {
+            BOOST_LOG_TRIVIAL(trace) << "Record " << record->getURL() << ": language not detected";
+        }
 
-            langRecords += n_langs;
+        stats.langRecords += n_langs;
 
-            try {
-                writer.write(record, options.skip_text_extraction, options.paragraph_identification);
-            } catch (const json::type_error &e) {
-                if (e.id == 316) {
-                    BOOST_LOG_TRIVIAL(trace) << "Record " << record.getURL() << ": utf8 conversion error";
-                    continue;
-                }
-                // If we get another type of json exception, throw it, as we do not expect it to happen
-                throw e;
-            }
+        result.action = ProcessedRecord::Action::write;
+        return result;
+    }
+
+    void WARCPreprocessor::commit(ProcessedRecord& result) {
+        if (!result.finished_input.empty()) {
+            updateLedger(result.finished_input, ledger.inputs[result.finished_input].offset, true);
+            return;
         }
+        stats += result.stats;
+
+        if (cdxj_writer.is_open() && result.record)
+            cdxj_writer.write(*result.record);
+
+        switch (result.action) {
+            case ProcessedRecord::Action::skip:
+                break;
+            case ProcessedRecord::Action::robots:
+                robots_warc_writer.writeRecord(result.record->getContent());
+                break;
+            case ProcessedRecord::Action::pdf:
+                pdf_warc_writer.writeRecord(result.record->getContent());
+                break;
+            case ProcessedRecord::Action::write:
+                if (!writer.write(*result.record, options.skip_text_extraction, options.paragraph_identification))
+                    BOOST_LOG_TRIVIAL(trace) << "Record " << result.record->getURL() << ": utf8 conversion error";
+                break;
+        }
+
+        if (result.record)
+            updateLedger(result.record->getFilename(), result.record->getOffset() + result.record->getSize(), false);
     }
 
     void WARCPreprocessor::printStatistics() const{
-        BOOST_LOG_TRIVIAL(info) << "total records: " << totalRecords;
+        BOOST_LOG_TRIVIAL(info) << "total records: " << stats.totalRecords;
         if (options.skip_text_extraction) {
-            BOOST_LOG_TRIVIAL(info) << "extracted records: " << textRecords;
+            BOOST_LOG_TRIVIAL(info) << "extracted records: " << stats.textRecords;
         } else {
-            BOOST_LOG_TRIVIAL(info) << "text records: " << textRecords;
-            BOOST_LOG_TRIVIAL(info) << "lang records: " << langRecords;
+            BOOST_LOG_TRIVIAL(info) << "text records: " << stats.textRecords;
+            BOOST_LOG_TRIVIAL(info) << "lang records: " << stats.langRecords;
         }
 
-        BOOST_LOG_TRIVIAL(info) << "total bytes: " << totalBytes;
+        BOOST_LOG_TRIVIAL(info) << "total bytes: " << stats.totalBytes;
         if (options.skip_text_extraction) {
-            BOOST_LOG_TRIVIAL(info) << "extracted bytes: " << textBytes;
+            BOOST_LOG_TRIVIAL(info) << "extracted bytes: " << stats.textBytes;
         } else {
-            BOOST_LOG_TRIVIAL(info) << "text bytes: " << textBytes;
-            BOOST_LOG_TRIVIAL(info) << "lang bytes: " << langBytes;
+            BOOST_LOG_TRIVIAL(info) << "text bytes: " << stats.textBytes;
+            BOOST_LOG_TRIVIAL(info) << "lang bytes: " << stats.langBytes;
+        }
+
+        for (const RecordFilterChain* filters : {&recordFilters, &textFilters})
+            for (const auto& rejected : filters->rejections())
+                BOOST_LOG_TRIVIAL(info) << "rejected by " << rejected.first << ": " << rejected.second;
+
+        if (options.recover) {
+            BOOST_LOG_TRIVIAL(info) << "skipped corrupt ranges: " << skipped.ranges;
+            BOOST_LOG_TRIVIAL(info) << "skipped corrupt bytes: " << skipped.bytes;
         }
     }
 
@@ -273,19 +683,30 @@ namespace warc2text {
         close();
     }
 
-    void WARCWriter::open(const std::string& warc_filename) {
-        filename = warc_filename;
-        if (not boost::algorithm::ends_with(filename, ".warc.gz"))
-            filename += ".warc.gz";
+    std::string WARCWriter::outputName(const std::string& warc_filename) {
+        if (not boost::algorithm::ends_with(warc_filename, ".warc.gz"))
+            return warc_filename + ".warc.gz";
+        return warc_filename;
+    }
+
+    void WARCWriter::open(const std::string& warc_filename, bool append) {
+        filename = outputName(warc_filename);
         auto filename_offset = filename.find_last_of('/');
         if (filename_offset != std::string::npos) {
             std::string folder = filename.substr(0, filename_offset);
             util::createDirectories(folder);
         }
-        warc = std::fopen(filename.c_str(), "wb");
+        warc = std::fopen(filename.c_str(), append ? "ab" : "wb");
+    }
+
+    void WARCWriter::checkpoint(std::map<std::string, std::size_t>& sizes) {
+        if (!warc)
+            return;
+        std::fflush(warc);
+        sizes[filename] = std::ftell(warc);
     }
 
-    bool WARCWriter::is_open() {
+    bool WARCWriter::is_open() const {
         return warc != nullptr;
     }
 
@@ -4,11 +4,20 @@
 #include "record.hh"
 #include "src/lang.hh"
 #include "warcreader.hh"
+#include "cdx.hh"
+#include "checkpoint.hh"
 #include "bilangwriter.hh"
+#include "recordfilter.hh"
 #include "util.hh"
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_set>
+#include <vector>
 #include <boost/regex.hpp>
 
 namespace warc2text {
@@ -19,10 +28,15 @@ namespace warc2text {
         public:
             WARCWriter();
             ~WARCWriter();
-            void open(const std::string& warc_filename);
+            // append adds the records of a resumed run after the ones written before it stopped
+            void open(const std::string& warc_filename, bool append = false);
             void close();
-            bool is_open();
+            bool is_open() const;
             void writeRecord(const std::string& content);
+            // flush what was written so far and put the size of the file in sizes
+            void checkpoint(std::map<std::string, std::size_t>& sizes);
+            // name of the file open(warc_filename) writes to
+            static std::string outputName(const std::string& warc_filename);
     };
 
     struct WARCPreprocessorOptions {
@@ -31,6 +45,8 @@ namespace warc2text {
         
         bool paragraph_identification{};
         bool skip_text_extraction{};
+        // also process conversion records (WET), whose payload is text that was extracted already
+        bool wet{};
 
         std::string output;
         std::unordered_set<std::string> output_files;
@@ -39,12 +55,84 @@ namespace warc2text {
         bool tag_filters_invert{};
         
         std::string url_filters_filename;
+
+        // only the records with a WARC-Date at or after start_date and before end_date are processed.
+        // Dates are compared as ISO 8601 text, so 2024-01 stands for the whole of January 2024.
+        std::string start_date;
+        std::string end_date;
         
         bool multilang{};
         bool encodeURLs{};
         bool robots_process{};
 
         size_t max_record_size;
+
+        // size of each read from the input files, and whether to map them into memory instead
+        size_t read_size{WARCReader::BUFFER_SIZE};
+        bool mmap_input{};
+        // number of reads from the input files kept in flight on background threads, 0 reads on demand
+        unsigned read_ahead{0};
+        // what inflates the gzip members of the input files that fit in memory in one piece
+        InflateEngine inflate_engine{InflateEngine::zlib};
+
+        // number of threads used to process records, 1 processes everything on the calling thread
+        unsigned threads{1};
+        // number of input files read at the same time, all feeding the same writer
+        unsigned parallel_files{1};
+        // number of threads inflating the gzip members of each input, 0 inflates on the reading thread
+        unsigned inflate_threads{0};
+        // number of records inflated ahead on a background thread, 0 inflates on the reading thread
+        unsigned inflate_ahead{0};
+
+        // reset and reuse the records that were written instead of allocating new ones
+        bool reuse_records{};
+
+        // skip corrupt records up to the next one that can be read, instead of the rest of the file
+        bool recover{};
+
+        // only the records starting at or after start_offset and before end_offset in each input are read
+        size_t start_offset{0};
+        size_t end_offset{std::numeric_limits<size_t>::max()};
+
+        // CDX(J) index listing the only records to process, and what to put in front of the WARC names in it
+        std::string cdx_filename;
+        std::string cdx_prefix;
+
+        // CDXJ index written for all records read, sorted by SURT at the end of the run if cdxj_sorted
+        std::string cdxj_filename;
+        bool cdxj_sorted{};
+
+        // ledger of how far the run got, saved every checkpoint_interval seconds and at the end.
+        // If it exists already, the run carries on from where it says. With deadline > 0 reading
+        // stops that many seconds after the start, and the run ends with a checkpoint.
+        std::string checkpoint_filename;
+        unsigned checkpoint_interval{60};
+        unsigned deadline{0};
+    };
+
+    struct RecordStatistics {
+        unsigned int totalRecords{};
+        unsigned int textRecords{};
+        unsigned int langRecords{};
+        unsigned int totalBytes{};
+        unsigned int textBytes{};
+        unsigned int langBytes{};
+
+        RecordStatistics& operator+=(const RecordStatistics& other);
+    };
+
+    /**
+     * Outcome of running a single WARC record through the filters, text extraction and
+     * language identification. Produced by process workers and handed to commit() in
+     * the original WARC order.
+     */
+    struct ProcessedRecord {
+        enum class Action { skip, robots, pdf, write };
+
+        Action action = Action::skip;
+        std::unique_ptr<Record> record; // also holds the raw record for the robots.txt and PDF passes
+        RecordStatistics stats;
+        std::string finished_input; // set instead of a record once all the records of this input were read
     };
 
     class WARCPreprocessor {
@@ -54,23 +142,47 @@ namespace warc2text {
             WARCPreprocessorOptions const &options;
             WARCWriter pdf_warc_writer;
             WARCWriter robots_warc_writer;
-            unsigned int totalRecords;
-            unsigned int textRecords;
-            unsigned int langRecords;
-            unsigned int totalBytes;
-            unsigned int textBytes;
-            unsigned int langBytes;
+            CDXJWriter cdxj_writer;
+            RecordStatistics stats;
+            SkipStatistics skipped; // corrupt parts of the input skipped by recover
+            std::mutex skipped_mutex;
             util::umap_tag_filters_regex tagFilters;
             boost::regex urlFilter;
-            const boost::regex statusFilter;
+            RecordFilterChain recordFilters; // whether a record is processed at all, PDFs included
+            RecordFilterChain textFilters; // whether text is extracted from it
+            WARCIndex index;
+            CheckpointLedger resumed; // where a previous run stopped, not changed after construction
+            CheckpointLedger ledger; // how far this run got, only changed by commit()
+            std::chrono::steady_clock::time_point started;
+            std::chrono::steady_clock::time_point last_checkpoint;
+            std::atomic<bool> stopped_early{false};
 
             static const std::unordered_set<std::string> removeExtensions;
-            bool URLfilter(const std::string& url) const;
+            void buildFilters();
+            bool headerFilter(std::string_view header) const;
+
+            // builds the record in recycled if there is one
+            ProcessedRecord processRecord(std::string content, const std::string& filename, std::size_t size, std::size_t offset, std::unique_ptr<Record> recycled = nullptr) const;
+            void commit(ProcessedRecord& result);
+            std::unique_ptr<RecordReader> openReader(const std::string& filename) const;
+            // returns false if it stopped at the deadline before the end of the input
+            bool processSerial(RecordReader& reader, const std::string& filename);
+            void addSkipStatistics(const RecordReader& reader);
+            bool pastDeadline() const;
+            void updateLedger(const std::string& input, std::size_t offset, bool done);
+            void checkpoint();
+            bool processParallel(const std::vector<std::string>& filenames);
 
         public:
             explicit WARCPreprocessor(RecordWriter &writer, LanguageDetector const &detector, WARCPreprocessorOptions const &options);
             void process(const std::string &filename);
+            // process all files, returns false if any of them could not be read
+            bool process(const std::vector<std::string> &filenames);
             void printStatistics() const;
+            // the WARCs the --cdx index refers to
+            std::vector<std::string> getIndexedFiles() const;
+            // whether reading stopped at the deadline, before the end of the input
+            bool stoppedEarly() const;
     };
 }
 
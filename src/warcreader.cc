@@ -1,102 +1,648 @@
 #include "warcreader.hh"
+#include "blockreader.hh"
+#include "util.hh"
 #include <boost/log/trivial.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <string_view>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // value of the Content-Length field of a WARC header, 0 if it is missing
+    std::size_t contentLength(std::string_view header) {
+        const std::string_view key = "content-length:";
+        for (std::size_t pos = header.find('\n'); pos != std::string_view::npos; pos = header.find('\n', pos + 1)) {
+            std::string_view line = header.substr(pos + 1, header.find('\n', pos + 1) - pos - 1);
+            if (line.size() <= key.size() || !boost::algorithm::iequals(line.substr(0, key.size()), key))
+                continue;
+            std::string_view value = line.substr(key.size());
+            value.remove_prefix(std::min(value.find_first_not_of(' '), value.size()));
+            std::size_t length = 0;
+            std::from_chars(value.data(), value.data() + value.size(), length);
+            return length;
+        }
+        return 0;
+    }
+}
 
 namespace warc2text {
+    SkipStatistics& SkipStatistics::operator+=(const SkipStatistics& other) {
+        ranges += other.ranges;
+        bytes += other.bytes;
+        return *this;
+    }
+
+    bool RecordReader::acceptHeader(std::string_view record) const {
+        if (!header_filter)
+            return true;
+        std::size_t header_end = util::findHeaderEnd(record);
+        return header_end == std::string_view::npos || header_filter(record.substr(0, header_end));
+    }
+
     WARCReader::WARCReader()
     {
-        s.zalloc = nullptr;
-        s.zfree = nullptr;
-        s.opaque = nullptr;
-        s.avail_in = 0;
-        s.next_in = buf.data();
+        format = Format::unknown;
+        next_in = nullptr;
+        avail_in = 0;
+        read_size = BUFFER_SIZE;
         bytes_read = 0;
+        range_end = std::numeric_limits<std::size_t>::max();
+        last_offset = std::numeric_limits<std::size_t>::max();
+        read_ahead = 0;
+        mapped = nullptr;
+        mapped_size = 0;
+    }
+
+    WARCReader::WARCReader(const std::string& filename, std::size_t read_size, bool use_mmap, unsigned read_ahead, InflateEngine engine) : WARCReader() {
+        this->read_size = std::max<std::size_t>(read_size, 1);
+        member_inflater = makeMemberInflater(engine);
+        openFile(filename, use_mmap, read_ahead);
+    }
+
+    WARCReader::~WARCReader(){
+        closeFile();
+    }
+
+    bool WARCReader::detectFormat() {
+        if (avail_in == 0 && readChunk() == 0)
+            return false;
+        if (next_in[0] == 0x28 || next_in[0] == 0x5d) {
+            // zstd frame, or the skippable frame holding the dictionary
+            format = Format::zstd;
+            decompressor = std::make_unique<ZstdDecompressor>();
+            if (next_in[0] == 0x5d)
+                readDictionary();
+        } else if (next_in[0] == 'W') {
+            format = Format::plain;
+        } else {
+            // anything else is left to zlib to complain about
+            format = Format::gzip;
+            decompressor = std::make_unique<GzipDecompressor>();
+        }
+        if (format != Format::gzip)
+            member_inflater.reset();
+        return true;
+    }
 
-        if (inflateInit2(&s, 32) != Z_OK) {
-          BOOST_LOG_TRIVIAL(error) << "Failed to init zlib";
-          abort();
+    void WARCReader::readDictionary() {
+        uint8_t header[8];
+        if (readInput(header, sizeof(header)) != sizeof(header) || readLE32(header) != 0x184D2A5D) {
+            BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": invalid zstd dictionary frame";
+            throw WARCFileException();
+        }
+        std::string dictionary(readLE32(header + 4), '\0');
+        if (readInput(reinterpret_cast<uint8_t*>(&dictionary[0]), dictionary.size()) != dictionary.size()
+                || !static_cast<ZstdDecompressor&>(*decompressor).loadDictionary(dictionary)) {
+            BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": invalid zstd dictionary";
+            throw WARCFileException();
         }
     }
 
-    WARCReader::WARCReader(const std::string& filename) : WARCReader() {
-        openFile(filename);
+    std::size_t WARCReader::readInput(uint8_t* data, std::size_t len) {
+        std::size_t done = 0;
+        while (done < len && (avail_in > 0 || readChunk() > 0)) {
+            std::size_t n = std::min(len - done, avail_in);
+            std::copy(next_in, next_in + n, data + done);
+            next_in += n;
+            avail_in -= n;
+            done += n;
+        }
+        return done;
     }
 
-    WARCReader::~WARCReader(){
-        inflateEnd(&s);
+    std::size_t WARCReader::skipInput(std::size_t len) {
+        std::size_t done = 0;
+        while (done < len && (avail_in > 0 || readChunk() > 0)) {
+            std::size_t n = std::min(len - done, avail_in);
+            next_in += n;
+            avail_in -= n;
+            done += n;
+        }
+        return done;
+    }
+
+    std::size_t WARCReader::getPlainRecord(std::string& out, std::size_t max_size) {
+        std::size_t offset = tell();
+        // the WARC header, up to the empty line that ends it
+        std::size_t header_end = std::string::npos;
+        while (header_end == std::string::npos) {
+            if (avail_in == 0 && readChunk() == 0) {
+                // nothing more to read
+                out.clear();
+                return 0;
+            }
+            // headers are small, so look at a few KB at a time instead of the whole chunk
+            std::size_t searched = out.size();
+            std::size_t len = std::min(avail_in, std::max<std::size_t>(searched, 4096));
+            out.append(reinterpret_cast<const char*>(next_in), len);
+            std::size_t pos = util::findHeaderEnd(out, searched < 2 ? 0 : searched - 2);
+            if (pos != std::string::npos) {
+                // leave what follows the header in the input
+                header_end = pos;
+                len -= out.size() - header_end;
+                out.resize(header_end);
+            }
+            next_in += len;
+            avail_in -= len;
+            if (out.compare(0, std::min<std::size_t>(out.size(), 5), "WARC/", 0, std::min<std::size_t>(out.size(), 5)) != 0
+                    || (header_end == std::string::npos && out.size() > max_size)) {
+                out.clear();
+                if (recover)
+                    return skipCorrupt(offset);
+                BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": invalid WARC record header at offset " << offset;
+                throw WARCFileException();
+            }
+        }
+
+        std::size_t length = contentLength(out);
+        bool rejected = header_filter && !header_filter(out);
+        if (rejected || header_end + length > max_size) {
+            if (!rejected)
+                BOOST_LOG_TRIVIAL(trace) << "WARC " << warc_filename << ": skipping large record";
+            out.clear();
+            if (skipInput(length) < length)
+                return 0;
+        } else {
+            out.resize(header_end + length);
+            if (readInput(reinterpret_cast<uint8_t*>(&out[header_end]), length) < length) {
+                // truncated record at the end of the file
+                out.clear();
+                return 0;
+            }
+        }
+        // and the \r\n\r\n that closes the record
+        while ((avail_in > 0 || readChunk() > 0) && (next_in[0] == '\r' || next_in[0] == '\n')) {
+            if (!out.empty())
+                out.push_back(next_in[0]);
+            ++next_in;
+            --avail_in;
+        }
+        return tell() - offset;
+    }
+
+    bool WARCReader::inflateMember(std::string& out, std::size_t max_size) {
+        if (avail_in == 0 && readChunk() == 0)
+            return false;
+        std::size_t offset = tell();
+        // a mapped file is in memory all the way to its end, otherwise only the rest of the chunk is
+        std::size_t in_len = mapped ? std::min(mapped_size, range_end) - offset : avail_in;
+        std::size_t consumed = 0;
+        if (!member_inflater->inflate(next_in, in_len, out, max_size, consumed))
+            return false;
+        if (consumed <= avail_in) {
+            next_in += consumed;
+            avail_in -= consumed;
+        } else {
+            // the member went past the current chunk of the mapping, continue after it
+            bytes_read = offset + consumed;
+            avail_in = 0;
+        }
+        return true;
     }
 
     std::size_t WARCReader::getRecord(std::string& out, std::size_t max_size){
-        int inflate_ret = 0;
+        StreamDecompressor::Status status = StreamDecompressor::Status::ok;
         out.clear();
+        if (format == Format::unknown && !detectFormat())
+            return 0;
+        if (tell() >= last_offset)
+            return 0;
+        if (format == Format::plain)
+            return getPlainRecord(out, max_size);
         std::size_t offset = tell();
+        // members that do not fit in memory in one piece are streamed below
+        if (member_inflater && inflateMember(out, max_size)) {
+            if (!acceptHeader(out))
+                out.clear();
+            return tell() - offset;
+        }
+        out.clear();
+        std::size_t used = 0; // bytes of out holding the record, the rest is room to decompress into
+        std::size_t header_end = std::string::npos;
+        // largest size out needs to grow to before the record gets skipped
+        std::size_t max_out = max_size < std::numeric_limits<std::size_t>::max() ? max_size + 1 : max_size;
         bool skip_record = false;
-        while (inflate_ret != Z_STREAM_END) {
-            if (s.avail_in == 0) {
+        bool out_full = false; // the decompressor may hold more output than there was room for
+        while (status != StreamDecompressor::Status::end) {
+            if (avail_in == 0 && !out_full) {
                 std::size_t len = readChunk();
                 if (len <= 0) {
                     // nothing more to read
                     out.clear();
                     return 0;
                 }
-                s.avail_in = len;
-                s.next_in = buf.data();
             }
-            // inflate until either stream end is reached, or there is no more data
-            while (inflate_ret != Z_STREAM_END && s.avail_in != 0) {
-                s.next_out = scratch.data();
-                s.avail_out = BUFFER_SIZE;
-                inflate_ret = inflate(&s, Z_NO_FLUSH);
-                if (inflate_ret != Z_OK && inflate_ret != Z_STREAM_END) {
-                    BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": error during decompressing";
+            // decompress until either the member ends, or there is no more data
+            while (status != StreamDecompressor::Status::end && (avail_in != 0 || out_full)) {
+                uint8_t* next_out;
+                std::size_t avail_out;
+                if (skip_record) {
+                    next_out = scratch.data();
+                    avail_out = scratch.size();
+                } else {
+                    // decompress straight into out, growing it only when it is full
+                    if (used == out.size())
+                        out.resize(std::max(used + 1, std::min(std::max(2 * used, scratch.size()), max_out)));
+                    next_out = reinterpret_cast<uint8_t*>(&out[used]);
+                    avail_out = out.size() - used;
+                }
+                std::size_t produced = avail_out;
+                status = decompressor->decompress(next_in, avail_in, next_out, avail_out);
+                if (status == StreamDecompressor::Status::error) {
                     out.clear();
+                    if (recover)
+                        return skipCorrupt(offset);
+                    BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": error during decompressing";
                     throw WARCFileException();
                 }
-                if (not skip_record) out.append(scratch.data(), scratch.data() + (scratch.size() - s.avail_out));
-                if (out.size() > max_size) {
+                out_full = avail_out == 0;
+                if (skip_record)
+                    continue;
+                produced -= avail_out;
+                std::size_t searched = used;
+                used += produced;
+
+                // once the WARC header is complete, make room for the whole record at once
+                if (header_end == std::string::npos) {
+                    std::string_view record(out.data(), used);
+                    std::size_t pos = util::findHeaderEnd(record, searched < 2 ? 0 : searched - 2);
+                    if (pos != std::string_view::npos) {
+                        header_end = pos;
+                        if (header_filter && !header_filter(record.substr(0, header_end))) {
+                            // only decompress the rest to find the end of the member
+                            out.clear();
+                            used = 0;
+                            skip_record = true;
+                            continue;
+                        }
+                        // + the \r\n\r\n that closes the record, and a bit so the decompressor can see the end of the member
+                        std::size_t expected = header_end + contentLength(record.substr(0, header_end)) + 4 + 16;
+                        if (expected > out.size() && expected <= max_out)
+                            out.resize(expected);
+                    }
+                }
+
+                if (used > max_size) {
                     BOOST_LOG_TRIVIAL(trace) << "WARC " << warc_filename << ": skipping large record";
                     out.clear();
+                    used = 0;
                     skip_record = true;
                 }
             }
-            if (inflate_ret == Z_STREAM_END) {
-                if (inflateReset(&s) != Z_OK) {
-                  BOOST_LOG_TRIVIAL(error) << "Failed to reset zlib";
-                  abort();
-                }
-                // next in and avail_in are updated while inflating, so no need to update them manually
-            }
         }
+        // next_in and avail_in are updated while decompressing, so no need to update them manually
+        decompressor->reset();
+        out.resize(used);
         return tell() - offset;
     }
 
-    void WARCReader::openFile(const std::string& filename){
-        warc_filename = filename;
-        bytes_read = 0;
+    std::size_t WARCReader::nextRecord(std::string& out, std::size_t& offset, std::size_t max_size) {
+        if (format == Format::unknown && !detectFormat()) {
+            out.clear();
+            offset = tell();
+            return 0;
+        }
+        return RecordReader::nextRecord(out, offset, max_size);
+    }
+
+    std::size_t WARCReader::getRecordAt(std::size_t offset, std::size_t length, std::string& out, std::size_t max_size) {
+        out.clear();
+        // the format, and the zstd dictionary, are at the start of the file
+        if (format == Format::unknown && !detectFormat())
+            return 0;
+        seekInput(offset);
+        range_end = length > 0 ? offset + length : std::numeric_limits<std::size_t>::max();
+        return getRecord(out, max_size);
+    }
+
+    void WARCReader::seekInput(std::size_t offset) {
+        if (!mapped) {
+            // reading ahead starts again from the new offset, it reads from the file descriptor
+            blocks.reset();
+            if (fseeko(file.get(), offset, SEEK_SET) != 0 || (read_ahead > 0 && lseek(fileno(file.get()), offset, SEEK_SET) < 0)) {
+                BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": could not seek to offset " << offset;
+                throw WARCFileException();
+            }
+            if (read_ahead > 0)
+                blocks = std::make_unique<AsyncBlockReader>(fileno(file.get()), warc_filename, read_size, read_ahead);
+        }
+        bytes_read = offset;
+        avail_in = 0;
+        // in case the previous record failed half way
+        if (decompressor)
+            decompressor->reset();
+    }
+
+    void WARCReader::setRange(std::size_t start, std::size_t end) {
+        last_offset = end;
+        // the format, and the zstd dictionary, are at the start of the file
+        if (format == Format::unknown && !detectFormat())
+            return;
+        std::size_t offset = start <= tell() ? tell() : findRecord(start);
+        seekInput(offset);
+        if (offset > start)
+            BOOST_LOG_TRIVIAL(debug) << "WARC " << warc_filename << ": skipped to the record at offset " << offset;
+    }
+
+    std::size_t WARCReader::skipCorrupt(std::size_t offset) {
+        std::size_t next = findRecord(offset + 1);
+        BOOST_LOG_TRIVIAL(warning) << "WARC " << warc_filename << ": corrupt record at offset " << offset
+            << ", skipped " << next - offset << " bytes up to offset " << next;
+        ++skipped.ranges;
+        skipped.bytes += next - offset;
+        seekInput(next);
+        return next - offset;
+    }
+
+    std::size_t WARCReader::findRecord(std::size_t start) {
+        // enough input after a candidate to decompress the start of a record from it,
+        // zstd needs a whole block, up to 128KB
+        const std::size_t probe_size = 256*1024;
+        // a plain record is recognised by the end of the one before it
+        const std::size_t lookbehind = format == Format::plain ? 4 : 0;
+        const uint8_t first = format == Format::gzip ? 0x1f : format == Format::zstd ? 0x28 : 'W';
+
+        std::size_t window_offset = start - std::min(start, lookbehind);
+        seekInput(window_offset);
+        std::vector<uint8_t> window;
+        std::size_t pos = start - window_offset; // first candidate not looked at
+        bool eof = false;
+        while (true) {
+            std::size_t limit = eof ? window.size() : window.size() - std::min(window.size(), probe_size);
+            if (pos >= limit) {
+                if (eof)
+                    return window_offset + window.size();
+                // forget what has been looked at already
+                std::size_t drop = pos - std::min(pos, lookbehind);
+                window.erase(window.begin(), window.begin() + drop);
+                window_offset += drop;
+                pos -= drop;
+                std::size_t have = window.size();
+                window.resize(have + 4 * probe_size);
+                std::size_t len = readInput(window.data() + have, 4 * probe_size);
+                window.resize(have + len);
+                eof = len < 4 * probe_size;
+                continue;
+            }
+            const void* found = std::memchr(window.data() + pos, first, limit - pos);
+            if (!found) {
+                pos = limit;
+                continue;
+            }
+            pos = static_cast<const uint8_t*>(found) - window.data();
+            if (isRecordStart(window.data() + pos, window.size() - pos, pos))
+                return window_offset + pos;
+            ++pos;
+        }
+    }
+
+    bool WARCReader::isRecordStart(const uint8_t* data, std::size_t len, std::size_t before) {
+        if (format == Format::plain)
+            return before >= 4 && len >= 7 && std::memcmp(data - 4, "\r\n\r\nWARC/1.", 11) == 0;
+        // something that looks like the start of a member, and decompresses to the start of a record
+        if (len < 4)
+            return false;
+        if (format == Format::gzip && (data[1] != 0x8b || data[2] != 0x08 || (data[3] & 0xe0) != 0))
+            return false;
+        if (format == Format::zstd && readLE32(data) != 0xFD2FB528)
+            return false;
+        std::array<uint8_t, 7> head;
+        uint8_t* out = head.data();
+        std::size_t out_len = head.size();
+        StreamDecompressor::Status status = StreamDecompressor::Status::ok;
+        decompressor->reset();
+        while (status == StreamDecompressor::Status::ok && out_len > 0 && len > 0) {
+            std::size_t in_left = len;
+            std::size_t out_left = out_len;
+            status = decompressor->decompress(data, len, out, out_len);
+            if (in_left == len && out_left == out_len)
+                break;
+        }
+        decompressor->reset();
+        return status != StreamDecompressor::Status::error && out_len == 0 && std::memcmp(head.data(), "WARC/1.", 7) == 0;
+    }
+
+    std::FILE* openWARCFile(const std::string& filename) {
+        std::FILE* file;
         if (filename.empty() || filename == "-")
-            file.reset(std::freopen(nullptr, "rb", stdin)); // make sure stdin is open in binary mode
+            file = std::freopen(nullptr, "rb", stdin); // make sure stdin is open in binary mode
         else
-            file.reset(std::fopen(filename.c_str(), "r"));
-        if (!file.get()) {
+            file = std::fopen(filename.c_str(), "r");
+        if (!file) {
             BOOST_LOG_TRIVIAL(error) << "WARC " << filename << ": file opening failed";
             throw WARCFileException();
         }
+        return file;
     }
 
-    std::size_t WARCReader::readChunk(){
-        std::size_t len = std::fread(buf.data(), sizeof(uint8_t), BUFFER_SIZE, file.get());
-        if (len > 0) {
-            bytes_read += len;
+    void WARCReader::openFile(const std::string& filename, bool use_mmap, unsigned read_ahead){
+        warc_filename = filename;
+        bytes_read = 0;
+        file.reset(openWARCFile(filename));
+
+        if (use_mmap && !filename.empty() && filename != "-") {
+            struct stat st;
+            int fd = fileno(file.get());
+            if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+                void* addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED) {
+                    ::madvise(addr, st.st_size, MADV_SEQUENTIAL);
+                    mapped = static_cast<const uint8_t*>(addr);
+                    mapped_size = st.st_size;
+                } else {
+                    BOOST_LOG_TRIVIAL(warning) << "WARC " << filename << ": could not map file into memory, reading it instead";
+                }
+            }
         }
-        if (std::ferror(file.get()) && !std::feof(file.get())) {
-            BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": error during reading";
-            throw WARCFileException();
+        this->read_ahead = read_ahead;
+        if (!mapped && read_ahead > 0)
+            blocks = std::make_unique<AsyncBlockReader>(fileno(file.get()), filename, read_size, read_ahead);
+        else if (!mapped)
+            buf.resize(read_size);
+    }
+
+    void WARCReader::closeFile() {
+        if (mapped)
+            ::munmap(const_cast<uint8_t*>(mapped), mapped_size);
+        mapped = nullptr;
+        mapped_size = 0;
+        blocks.reset();
+        file.reset();
+    }
+
+    std::size_t WARCReader::readChunk(){
+        std::size_t len;
+        std::size_t end = mapped ? std::min(mapped_size, range_end) : range_end;
+        std::size_t want = bytes_read < end ? std::min(read_size, end - bytes_read) : 0;
+        if (mapped) {
+            // no copy, the decompressor reads from the mapping directly
+            len = want;
+            next_in = mapped + bytes_read;
+        } else if (blocks) {
+            const uint8_t* data = nullptr;
+            len = blocks->next(data);
+            next_in = data;
+        } else {
+            len = std::fread(buf.data(), sizeof(uint8_t), want, file.get());
+            next_in = buf.data();
+            if (std::ferror(file.get()) && !std::feof(file.get())) {
+                BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": error during reading";
+                throw WARCFileException();
+            }
         }
+        bytes_read += len;
+        avail_in = len;
         return len;
     }
 
     std::size_t WARCReader::tell() const {
-        return bytes_read - s.avail_in;
+        return bytes_read - avail_in;
+    }
+
+    IndexedWARCReader::IndexedWARCReader(std::unique_ptr<WARCReader> reader, const std::string& filename, std::vector<IndexEntry> entries) :
+        reader(std::move(reader)),
+        warc_filename(filename),
+        entries(std::move(entries)),
+        next(0)
+    {}
+
+    std::size_t IndexedWARCReader::getRecord(std::string& out, std::size_t max_size) {
+        out.clear();
+        if (next == entries.size())
+            return 0;
+        const IndexEntry& entry = entries[next++];
+        std::size_t size = 0;
+        try {
+            size = reader->getRecordAt(entry.offset, entry.length, out, max_size);
+        } catch (const WARCFileException& e) {
+            out.clear();
+        }
+        if (size == 0) {
+            BOOST_LOG_TRIVIAL(error) << "WARC " << warc_filename << ": could not read the record at offset " << entry.offset;
+            // not the end of the index, only of this record
+            return std::max<std::size_t>(entry.length, 1);
+        }
+        return size;
+    }
+
+    std::size_t IndexedWARCReader::tell() const {
+        return next < entries.size() ? entries[next].offset : 0;
+    }
+
+    SkipStatistics IndexedWARCReader::getSkipStatistics() const {
+        return reader->getSkipStatistics();
+    }
+
+    ReadAheadWARCReader::ReadAheadWARCReader(std::unique_ptr<RecordReader> reader, std::size_t ahead, std::size_t max_size) :
+        reader(std::move(reader)),
+        max_size(max_size),
+        ring(std::max<std::size_t>(ahead, 1)),
+        head(0),
+        ready(0),
+        finished(false),
+        stop(false),
+        end_offset(0),
+        error(),
+        thread(&ReadAheadWARCReader::run, this)
+    {}
+
+    ReadAheadWARCReader::~ReadAheadWARCReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+
+    void ReadAheadWARCReader::run() {
+        try {
+            while (true) {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this]{ return stop || ready < ring.size(); });
+                if (stop)
+                    return;
+                // the caller never touches a slot that is not ready, so fill it without the lock
+                Slot& slot = ring[(head + ready) % ring.size()];
+                lock.unlock();
+
+                slot.size = reader->nextRecord(slot.content, slot.offset, max_size);
+                slot.skipped = reader->getSkipStatistics();
+
+                lock.lock();
+                if (slot.size == 0) {
+                    finished = true;
+                    end_offset = slot.offset;
+                    end_skipped = slot.skipped;
+                } else {
+                    ++ready;
+                }
+                lock.unlock();
+                changed.notify_all();
+                if (slot.size == 0)
+                    return;
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+            finished = true;
+            end_offset = reader->tell();
+            end_skipped = reader->getSkipStatistics();
+        }
+        changed.notify_all();
+    }
+
+    std::size_t ReadAheadWARCReader::getRecord(std::string& out, std::size_t max_size) {
+        std::size_t offset;
+        return nextRecord(out, offset, max_size);
+    }
+
+    std::size_t ReadAheadWARCReader::nextRecord(std::string& out, std::size_t& offset, std::size_t max_size) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]{ return ready > 0 || finished; });
+        if (ready == 0) {
+            offset = end_offset;
+            skipped = end_skipped;
+            out.clear();
+            if (error)
+                std::rethrow_exception(error);
+            return 0;
+        }
+        Slot& slot = ring[head];
+        // hand out the record and give the old buffer of the caller to the ring
+        std::swap(out, slot.content);
+        std::size_t size = slot.size;
+        offset = slot.offset;
+        skipped = slot.skipped;
+        head = (head + 1) % ring.size();
+        --ready;
+        lock.unlock();
+        changed.notify_all();
+
+        if (out.size() > max_size) {
+            BOOST_LOG_TRIVIAL(trace) << "skipping large record";
+            out.clear();
+        }
+        return size;
+    }
+
+    SkipStatistics ReadAheadWARCReader::getSkipStatistics() const {
+        // the background thread may be reading the next record into the wrapped reader, so these
+        // are the ones it had when it read the last record handed out
+        std::lock_guard<std::mutex> lock(mutex);
+        return skipped;
+    }
+
+    std::size_t ReadAheadWARCReader::tell() const {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]{ return ready > 0 || finished; });
+        return ready > 0 ? ring[head].offset : end_offset;
     }
 
 } // warc2text
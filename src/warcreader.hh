@@ -2,37 +2,200 @@
 #define WARC2TEXT_WARCREADER_HH
 
 #include "util/file.hh"
-#include "zlib.h"
+#include "inflater.hh"
+#include "decompressor.hh"
+#include "cdx.hh"
 #include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <cstdint>
+#include <cstdio>
 #include <exception>
+#include <functional>
+#include <string_view>
 
 namespace warc2text {
+    class AsyncBlockReader;
+
     class WARCFileException : public std::exception {
           virtual const char* what() const throw() { return "Error reading WARCFile"; }
     };
 
-    class WARCReader {
+    // open a WARC for binary reading, an empty filename or "-" reads from stdin
+    std::FILE* openWARCFile(const std::string& filename);
+
+    // decides from the WARC header of a record, up to and including the empty line, whether to read the rest of it
+    using HeaderFilter = std::function<bool(std::string_view header)>;
+
+    // corrupt parts of a WARC that were skipped to carry on with the records after them
+    struct SkipStatistics {
+        std::size_t ranges{};
+        std::size_t bytes{};
+
+        SkipStatistics& operator+=(const SkipStatistics& other);
+    };
+
+    /**
+     * Generic interface for reading the records of a WARC one at a time.
+     */
+    class RecordReader {
         public:
+            // read the next record into out, returns its compressed size or 0 at the end of the input.
+            // out is left empty if the record is larger than max_size.
+            virtual std::size_t getRecord(std::string& out, std::size_t max_size = 1024*1024*20) = 0; //20MB
+            // byte offset in the WARC of the next record getRecord will return
+            virtual std::size_t tell() const = 0;
+            // getRecord that also puts the offset of the record it returns in offset. Readers that
+            // read ahead keep the offset with each record, where tell() has to wait for them.
+            virtual std::size_t nextRecord(std::string& out, std::size_t& offset, std::size_t max_size = 1024*1024*20) {
+                offset = tell();
+                return getRecord(out, max_size);
+            }
+            // records turned down by filter are read past and left empty, like records larger than max_size.
+            // Set it before the first getRecord.
+            void setHeaderFilter(HeaderFilter filter) { header_filter = std::move(filter); }
+            // instead of giving up on the rest of the WARC at the first record that cannot be decompressed
+            // or parsed, carry on at the next record that can. getRecord returns the corrupt range as
+            // an empty record. Needs a file that can be seeked.
+            void setRecover(bool recover) { this->recover = recover; }
+            // what was skipped so far because of recover
+            virtual SkipStatistics getSkipStatistics() const { return skipped; }
+            virtual ~RecordReader() = default;
+        protected:
+            HeaderFilter header_filter;
+            bool recover = false;
+            SkipStatistics skipped;
+
+            // false if the header filter turns down the record
+            bool acceptHeader(std::string_view record) const;
+    };
+
+    /**
+     * Reads the records of a WARC compressed per record with gzip, or with zstd as
+     * described by the WARC zstd spec, including the dictionary frame that may come
+     * first. Uncompressed WARCs are split into records by their Content-Length.
+     * The format is recognized from the first bytes of the file.
+     */
+    class WARCReader : public RecordReader {
+        public:
+            static const std::size_t BUFFER_SIZE = 4096;
+
             WARCReader();
-            explicit WARCReader(const std::string& filename);
-            std::size_t getRecord(std::string& out, std::size_t max_size = 1024*1024*20); //20MB
-            std::size_t tell() const;
-            ~WARCReader();
+            // read_size is the size of each read from the file. With use_mmap regular files are
+            // mapped into memory instead and inflated straight from the mapping. Otherwise, with
+            // read_ahead > 0 up to that many reads are kept in flight on background threads.
+            // engine picks what inflates members that are completely in memory.
+            explicit WARCReader(const std::string& filename, std::size_t read_size = BUFFER_SIZE, bool use_mmap = false, unsigned read_ahead = 0, InflateEngine engine = InflateEngine::zlib);
+            std::size_t getRecord(std::string& out, std::size_t max_size = 1024*1024*20) override; //20MB
+            // the offset of the first record is only known once the zstd dictionary before it was read
+            std::size_t nextRecord(std::string& out, std::size_t& offset, std::size_t max_size = 1024*1024*20) override;
+            // read the record at offset instead of the next one, reading no further than offset + length
+            // if length is not 0. Needs a file that can be seeked.
+            std::size_t getRecordAt(std::size_t offset, std::size_t length, std::string& out, std::size_t max_size = 1024*1024*20);
+            // only read the records that start at or after start and before end: skip to the first
+            // record boundary at or after start, and stop at the first record starting at or after end.
+            // Offsets stay the ones in the whole file. Needs a file that can be seeked, call it before
+            // the first getRecord.
+            void setRange(std::size_t start, std::size_t end);
+            std::size_t tell() const override;
+            ~WARCReader() override;
         private:
             util::scoped_FILE file;
             std::string warc_filename;
-            z_stream s{};
-            static const std::size_t BUFFER_SIZE = 4096;
-            std::array<uint8_t, BUFFER_SIZE> buf;
-            std::array<uint8_t, BUFFER_SIZE> scratch;
+            enum class Format { unknown, gzip, zstd, plain };
+            Format format;
+            std::unique_ptr<StreamDecompressor> decompressor; // null for plain WARCs
+            const uint8_t* next_in;
+            std::size_t avail_in;
+            std::size_t read_size;
+            std::vector<uint8_t> buf;
+            std::array<uint8_t, 64*1024> scratch; // sink for records that are being skipped
             std::size_t bytes_read;
+            std::size_t range_end; // file offset readChunk stops at
+            std::size_t last_offset; // no record starting at or after this offset is read
+            const uint8_t* mapped;
+            std::size_t mapped_size;
+            unsigned read_ahead;
+            std::unique_ptr<AsyncBlockReader> blocks;
+            std::unique_ptr<MemberInflater> member_inflater; // null to always stream through zlib
 
-            void openFile(const std::string& filename);
+            bool detectFormat();
+            void readDictionary();
+            std::size_t readInput(uint8_t* data, std::size_t len);
+            std::size_t skipInput(std::size_t len);
+            std::size_t getPlainRecord(std::string& out, std::size_t max_size);
+            std::size_t findRecord(std::size_t start);
+            std::size_t skipCorrupt(std::size_t offset);
+            bool isRecordStart(const uint8_t* data, std::size_t len, std::size_t before);
+            void seekInput(std::size_t offset);
+            bool inflateMember(std::string& out, std::size_t max_size);
+            void openFile(const std::string& filename, bool use_mmap, unsigned read_ahead);
             void closeFile();
             std::size_t readChunk();
     };
+
+    /**
+     * Reads only the records of a WARC that are listed in an index, seeking straight
+     * to each of them instead of decompressing everything in between. Records that
+     * cannot be read are logged and returned empty.
+     */
+    class IndexedWARCReader : public RecordReader {
+        public:
+            IndexedWARCReader(std::unique_ptr<WARCReader> reader, const std::string& filename, std::vector<IndexEntry> entries);
+            std::size_t getRecord(std::string& out, std::size_t max_size = 1024*1024*20) override;
+            std::size_t tell() const override;
+            SkipStatistics getSkipStatistics() const override;
+        private:
+            std::unique_ptr<WARCReader> reader;
+            std::string warc_filename;
+            std::vector<IndexEntry> entries;
+            std::size_t next; // next entry to read
+    };
+
+    /**
+     * Wraps another reader and runs it on a background thread, which inflates up to
+     * `ahead` records into a ring of buffers while the caller is busy with the previous
+     * ones. Buffers are swapped in and out of the ring, so they are reused across
+     * records. Offsets and sizes are the ones the wrapped reader reports, and so are
+     * header filtering and recovery: set them on the wrapped reader.
+     */
+    class ReadAheadWARCReader : public RecordReader {
+        public:
+            ReadAheadWARCReader(std::unique_ptr<RecordReader> reader, std::size_t ahead, std::size_t max_size = 1024*1024*20);
+            std::size_t getRecord(std::string& out, std::size_t max_size = 1024*1024*20) override;
+            std::size_t nextRecord(std::string& out, std::size_t& offset, std::size_t max_size = 1024*1024*20) override;
+            // waits for the background thread to read the next record, use nextRecord instead
+            std::size_t tell() const override;
+            SkipStatistics getSkipStatistics() const override;
+            ~ReadAheadWARCReader() override;
+        private:
+            struct Slot {
+                std::string content;
+                std::size_t offset = 0;
+                std::size_t size = 0;
+                SkipStatistics skipped; // of the wrapped reader once it read the record
+            };
+
+            std::unique_ptr<RecordReader> reader;
+            std::size_t max_size;
+            std::vector<Slot> ring;
+            std::size_t head; // next slot to hand out
+            std::size_t ready; // number of filled slots starting at head
+            bool finished;
+            bool stop;
+            std::size_t end_offset;
+            SkipStatistics end_skipped; // of the wrapped reader once it finished
+            std::exception_ptr error;
+            mutable std::mutex mutex;
+            mutable std::condition_variable changed;
+            std::thread thread;
+
+            void run();
+    };
 }
 
 #endif
@@ -1,18 +1,121 @@
-#include <cctype>
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include "xh_scanner.hh"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define XH_SCANNER_BLOCKS
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define XH_SCANNER_BLOCKS
+#endif
+
 namespace markup {
 
-    // case sensitive string equality test
-    // s_lowcase shall be lowercase string
-    inline bool equal(const char *s, const char *s1, size_t length) {
-        return strncmp(s, s1, length) == 0;
+    namespace {
+
+        bool is_whitespace(char c) {
+            return c <= ' '
+                   && (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f');
+        }
+
+        // Blocks of input tested with one instruction per comparison. Each test gives a mask
+        // with bit i set if byte i of the block matches.
+#if defined(__AVX2__)
+        typedef __m256i block;
+        const std::ptrdiff_t BLOCK_SIZE = 32;
+        const uint32_t ALL_BYTES = 0xffffffffu;
+
+        inline block load(const char *p) { return _mm256_loadu_si256(reinterpret_cast<const block *>(p)); }
+        inline block equals(block b, char c) { return _mm256_cmpeq_epi8(b, _mm256_set1_epi8(c)); }
+        inline block either(block a, block b) { return _mm256_or_si256(a, b); }
+        inline uint32_t mask(block b) { return static_cast<uint32_t>(_mm256_movemask_epi8(b)); }
+
+        // same as is_whitespace: the bytes from '\t' to '\r' but '\v', and ' '
+        inline block whitespace(block b) {
+            block controls = _mm256_and_si256(_mm256_cmpgt_epi8(b, _mm256_set1_epi8('\t' - 1)),
+                                              _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), b));
+            return either(_mm256_andnot_si256(equals(b, '\v'), controls), equals(b, ' '));
+        }
+#elif defined(__SSE2__)
+        typedef __m128i block;
+        const std::ptrdiff_t BLOCK_SIZE = 16;
+        const uint32_t ALL_BYTES = 0xffffu;
+
+        inline block load(const char *p) { return _mm_loadu_si128(reinterpret_cast<const block *>(p)); }
+        inline block equals(block b, char c) { return _mm_cmpeq_epi8(b, _mm_set1_epi8(c)); }
+        inline block either(block a, block b) { return _mm_or_si128(a, b); }
+        inline uint32_t mask(block b) { return static_cast<uint32_t>(_mm_movemask_epi8(b)); }
+
+        // same as is_whitespace: the bytes from '\t' to '\r' but '\v', and ' '
+        inline block whitespace(block b) {
+            block controls = _mm_and_si128(_mm_cmpgt_epi8(b, _mm_set1_epi8('\t' - 1)),
+                                           _mm_cmplt_epi8(b, _mm_set1_epi8('\r' + 1)));
+            return either(_mm_andnot_si128(equals(b, '\v'), controls), equals(b, ' '));
+        }
+#endif
+
+        // what ends a word: whitespace, or the '<' and '&' that start markup
+        struct word_end {
+            static bool match(char c) { return c == '<' || c == '&' || is_whitespace(c); }
+#ifdef XH_SCANNER_BLOCKS
+            static uint32_t match(block b) { return mask(either(whitespace(b), either(equals(b, '<'), equals(b, '&')))); }
+#endif
+        };
+
+        // what ends a run of whitespace
+        struct space_end {
+            static bool match(char c) { return !is_whitespace(c); }
+#ifdef XH_SCANNER_BLOCKS
+            static uint32_t match(block b) { return ~mask(whitespace(b)) & ALL_BYTES; }
+#endif
+        };
+
+        // what ends an attribute value without quotes
+        struct attr_value_end {
+            static bool match(char c) { return c == '>' || is_whitespace(c); }
+#ifdef XH_SCANNER_BLOCKS
+            static uint32_t match(block b) { return mask(either(whitespace(b), equals(b, '>'))); }
+#endif
+        };
+
+        // the characters the end tag of a script or style element is looked for at
+        struct tag_delimiter {
+            static bool match(char c) { return c == '<' || c == '>'; }
+#ifdef XH_SCANNER_BLOCKS
+            static uint32_t match(block b) { return mask(either(equals(b, '<'), equals(b, '>'))); }
+#endif
+        };
+
+        // first character in [p, end) Class matches, end if there is none
+        template <typename Class>
+        const char *find(const char *p, const char *end) {
+#ifdef XH_SCANNER_BLOCKS
+            for (; end - p >= BLOCK_SIZE; p += BLOCK_SIZE)
+                if (uint32_t found = Class::match(load(p)))
+                    return p + __builtin_ctz(found);
+#endif
+            while (p < end && !Class::match(*p)) ++p;
+            return p;
+        }
+
+        // case sensitive string equality test
+        // s_lowcase shall be lowercase string
+        inline bool equal(const char *s, const char *s1, size_t length) {
+            return strncmp(s, s1, length) == 0;
+        }
     }
 
-    const char *scanner::get_value() {
-        value[value_length] = 0;
-        return value;
+    scanner::token_type scanner::get_token() {
+        switch (c_scan) {
+            case reader::head: return scan_head();
+            case reader::comment: return scan_comment();
+            case reader::cdata: return scan_cdata();
+            case reader::special: return scan_special();
+            case reader::entity_decl: return scan_entity_decl();
+            default: return scan_body();
+        }
     }
 
     const char *scanner::get_attr_name() {
@@ -26,43 +129,16 @@ namespace markup {
     }
 
     scanner::token_type scanner::scan_body() {
-        char c = get_char();
-
-        value_length = 0;
+        value = {};
 
-        bool ws;
+        if (p == end) return TT_EOF;
+        const char *start = p++;
+        if (*start == '<') return scan_tag();
 
-        if (c == 0) return TT_EOF;
-        else if (c == '<') return scan_tag();
-        // else if (c == '&') {
-        //     c = scan_entity();
-        //     ws = is_whitespace(c);
-        // }
-        else
-            ws = is_whitespace(c);
-
-        while (true) {
-            append_value(c);
-            c = get_char();
-            if (c == 0) {
-                push_back(c);
-                break;
-            }
-            if (c == '<') {
-                push_back(c);
-                break;
-            }
-            if (c == '&') {
-                push_back(c);
-                break;
-            }
-
-            if (is_whitespace(c) != ws) {
-                push_back(c);
-                break;
-            }
-
-        }
+        // the first character starts the run whatever it is, '&' included
+        bool ws = is_whitespace(*start);
+        p = ws ? find<space_end>(p, end) : find<word_end>(p, end);
+        set_value(start, p);
         return ws ? TT_SPACE : TT_WORD;
     }
 
@@ -70,25 +146,30 @@ namespace markup {
         char c = skip_whitespace();
 
         if (c == '>') {
+            // an empty name, as in "<>", would only compare what is left of an earlier tag
+            if (tag_name_length == 0) {
+                c_scan = reader::body;
+                return scan_body();
+            }
             if (equal(tag_name, "script", 6)){
                 // script is special because we want to parse the attributes,
                 // but not the content
-                c_scan = &scanner::scan_special;
+                c_scan = reader::special;
                 return scan_special();
             }
             else if (equal(tag_name, "style", 5)) {
                 // same with style
-                c_scan = &scanner::scan_special;
+                c_scan = reader::special;
                 return scan_special();
             }
-            c_scan = &scanner::scan_body;
+            c_scan = reader::body;
             return scan_body();
         }
         if (c == '/') {
             char t = get_char();
             if (t == '>') {
                 // self closing tag
-                c_scan = &scanner::scan_body;
+                c_scan = reader::body;
                 return TT_TAG_END;
             }
             else {
@@ -98,7 +179,7 @@ namespace markup {
         }
 
         attr_name_length = 0;
-        value_length = 0;
+        value = {};
 
         // attribute name...
         while (c != '=') {
@@ -123,41 +204,29 @@ namespace markup {
         c = skip_whitespace();
         // attribute value...
 
-        if (c == '\"') {
-            c = get_char();
-            while (c) {
-                if (c == '\"') return TT_ATTR;
-                // if (c == '&') c = scan_entity();
-                append_value(c);
-                c = get_char();
-            }
-        } else if (c == '\'') // allowed in html
+        if (c == '\"' || c == '\'') // single quotes allowed in html
         {
-            c = get_char();
-            while (c) {
-                if (c == '\'') return TT_ATTR;
-                // if (c == '&') c = scan_entity();
-                append_value(c);
-                c = get_char();
+            const char *quote = static_cast<const char *>(std::memchr(p, c, end - p));
+            if (!quote) {
+                p = end;
+                return TT_ERROR;
             }
-        } else  // scan token, allowed in html: e.g. align=center
-        {
-            c = get_char();
-            do {
-                if (is_whitespace(c)) return TT_ATTR;
-                /* these two removed in favour of better html support:
-                if( c == '/' || c == '>' ) { push_back(c); return TT_ATTR; }
-                if( c == '&' ) c = scan_entity();*/
-                if (c == '>') {
-                    push_back(c);
-                    return TT_ATTR;
-                }
-                append_value(c);
-                c = get_char();
-            } while (c);
+            set_value(p, quote);
+            p = quote + 1;
+            return TT_ATTR;
         }
 
-        return TT_ERROR;
+        // scan token, allowed in html: e.g. align=center
+        // the character c the value starts with is left out, as it always was
+        const char *stop = find<attr_value_end>(p, end);
+        if (stop == end) {
+            p = end;
+            return TT_ERROR;
+        }
+        set_value(p, stop);
+        // whitespace after the value is consumed, '>' is left for the next token
+        p = *stop == '>' ? stop : stop + 1;
+        return TT_ATTR;
     }
 
     // caller already consumed '<'
@@ -181,19 +250,19 @@ namespace markup {
             switch (tag_name_length) {
                 case 3:
                     if (equal(tag_name, "!--", 3)) {
-                        c_scan = &scanner::scan_comment;
+                        c_scan = reader::comment;
                         return TT_COMMENT_START;
                     }
                     break;
                 case 8:
                     if (equal(tag_name, "![CDATA[", 8)) {
-                        c_scan = &scanner::scan_cdata;
+                        c_scan = reader::cdata;
                         return TT_CDATA_START;
                     }
                     break;
                 case 7:
                     if (equal(tag_name, "!ENTITY", 8)) {
-                        c_scan = &scanner::scan_entity_decl;
+                        c_scan = reader::entity_decl;
                         return TT_ENTITY_START;
                     }
                     break;
@@ -210,7 +279,7 @@ namespace markup {
         } else
             push_back(c);
 
-        c_scan = &scanner::scan_head;
+        c_scan = reader::head;
         return TT_TAG_START;
     }
 
@@ -223,25 +292,8 @@ namespace markup {
         return 0;
     }
 
-    void scanner::push_back(char c) { input_char = c; }
-
-    char scanner::get_char() {
-        if (input_char) {
-            char t(input_char);
-            input_char = 0;
-            return t;
-        }
-        return input.get_char();
-    }
-
-    bool scanner::is_whitespace(char c) {
-        return c <= ' '
-               && (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f');
-    }
-
-    void scanner::append_value(char c) {
-        if (value_length < (MAX_TOKEN_SIZE - 1))
-            value[value_length++] = c;
+    void scanner::set_value(const char *begin, const char *stop) {
+        value = std::string_view(begin, std::min<std::ptrdiff_t>(stop - begin, MAX_TOKEN_SIZE - 1));
     }
 
     void scanner::append_attr_name(char c) {
@@ -256,134 +308,106 @@ namespace markup {
 
     scanner::token_type scanner::scan_comment() {
         if (got_tail) {
-            c_scan = &scanner::scan_body;
+            c_scan = reader::body;
             got_tail = false;
             return TT_COMMENT_END;
         }
-        for (value_length = 0; value_length < (MAX_TOKEN_SIZE - 1); ++value_length) {
-            char c = get_char();
-            if (c == 0) return TT_EOF;
-            value[value_length] = c;
-
-            if (value_length >= 2
-                && value[value_length] == '>'
-                && value[value_length - 1] == '-'
-                && value[value_length - 2] == '-') {
-                got_tail = true;
-                value_length -= 2;
-                break;
-            }
-        }
-        return TT_DATA;
-    }
-
-    scanner::token_type scanner::scan_special() {
-        if (got_tail) {
-            c_scan = &scanner::scan_body;
-            got_tail = false;
-            return TT_TAG_END;
-        }
-        for (value_length = 0; value_length < (MAX_TOKEN_SIZE - 1); ++value_length) {
-            char c = get_char();
-            if (c == 0)
-                return TT_EOF;
-
-            // in case MAX_TOKEN_SIZE limit breaks up the end tag
-            if (c == '<' && value_length + tag_name_length + 3 >= MAX_TOKEN_SIZE) {
-                push_back(c);
-                break;
-            }
-
-            value[value_length] = c;
-
-            if (c == '>' && value_length >= tag_name_length + 2) {
-                unsigned int i = tag_name_length - 1;
-                do {
-                    if (value[value_length + i - tag_name_length] != tag_name[i])
-                        break;
-                    --i;
-                } while (i > 0);
-                if (i > 0)
-                    continue;
-                if (value[value_length - tag_name_length - 1] != '/')
-                    continue;
-                if (value[value_length - tag_name_length - 2] != '<')
-                    continue;
-
-                got_tail = true;
-                value_length = value_length - tag_name_length - 2;
-                break;
-            }
-        }
-        return TT_DATA;
+        return scan_until_tail('-');
     }
 
     scanner::token_type scanner::scan_cdata() {
         if (got_tail) {
-            c_scan = &scanner::scan_body;
+            c_scan = reader::body;
             got_tail = false;
             return TT_CDATA_END;
         }
-        for (value_length = 0; value_length < (MAX_TOKEN_SIZE - 1); ++value_length) {
-            char c = get_char();
-            if (c == 0) return TT_EOF;
-            value[value_length] = c;
-
-            if (value_length >= 2
-                && value[value_length] == '>'
-                && value[value_length - 1] == ']'
-                && value[value_length - 2] == ']') {
-                got_tail = true;
-                value_length -= 2;
-                break;
+        return scan_until_tail(']');
+    }
+
+    // The content used to be read MAX_TOKEN_SIZE - 1 characters at a time, and a tail split
+    // between two of those reads was not seen. It is looked for the same way here, so that
+    // documents end up with the same text they always did.
+    scanner::token_type scanner::scan_until_tail(char mark) {
+        const char *start = p;
+        while (true) {
+            const char *chunk = p;
+            const char *stop = end - chunk > MAX_TOKEN_SIZE - 1 ? chunk + MAX_TOKEN_SIZE - 1 : end;
+            for (const char *q = chunk + 2; q < stop; ++q) {
+                q = static_cast<const char *>(std::memchr(q, '>', stop - q));
+                if (!q) break;
+                if (q[-1] == mark && q[-2] == mark) {
+                    got_tail = true;
+                    value = std::string_view(start, q - 2 - start);
+                    p = q + 1;
+                    return TT_DATA;
+                }
             }
+            p = stop;
+            if (stop == end) return TT_EOF;
         }
-        return TT_DATA;
     }
 
-    scanner::token_type scanner::scan_pi() {
+    // Same MAX_TOKEN_SIZE - 1 character reads as scan_until_tail, except that a '<' too close to
+    // the end of one starts the next one, so that the end tag is not split.
+    scanner::token_type scanner::scan_special() {
         if (got_tail) {
-            c_scan = &scanner::scan_body;
+            c_scan = reader::body;
             got_tail = false;
-            return TT_PI_END;
+            return TT_TAG_END;
         }
-        for (value_length = 0; value_length < (MAX_TOKEN_SIZE - 1); ++value_length) {
-            char c = get_char();
-            if (c == 0) return TT_EOF;
-            value[value_length] = c;
-
-            if (value_length >= 1
-                && value[value_length] == '>'
-                && value[value_length - 1] == '?') {
-                got_tail = true;
-                value_length -= 1;
-                break;
+        const std::ptrdiff_t length = tag_name_length;
+        const char *start = p;
+        while (true) {
+            const char *chunk = p;
+            const char *stop = end - chunk > MAX_TOKEN_SIZE - 1 ? chunk + MAX_TOKEN_SIZE - 1 : end;
+            for (const char *q = find<tag_delimiter>(chunk, stop); q < stop; q = find<tag_delimiter>(q + 1, stop)) {
+                std::ptrdiff_t offset = q - chunk;
+                if (*q == '<') {
+                    if (offset + length + 3 >= MAX_TOKEN_SIZE) {
+                        stop = q;
+                        break;
+                    }
+                }
+                // "</" and the tag name, bar its first character, right before the '>'
+                else if (offset >= length + 2
+                         && q[-length - 2] == '<' && q[-length - 1] == '/'
+                         && std::memcmp(q - length + 1, tag_name + 1, length - 1) == 0) {
+                    got_tail = true;
+                    value = std::string_view(start, q - length - 2 - start);
+                    p = q + 1;
+                    return TT_DATA;
+                }
             }
+            p = stop;
+            if (stop == end) return TT_EOF;
         }
-        return TT_DATA;
     }
 
     scanner::token_type scanner::scan_entity_decl() {
         if (got_tail) {
-            c_scan = &scanner::scan_body;
+            c_scan = reader::body;
             got_tail = false;
             return TT_ENTITY_END;
         }
-        char t;
-        unsigned int tc = 0;
-        for (value_length = 0; value_length < (MAX_TOKEN_SIZE - 1); ++value_length) {
-            t = get_char();
-            if (t == 0) return TT_EOF;
-            value[value_length] = t;
-            if (t == '\"') tc++;
-            else if (t == '>' && (tc & 1u) == 0) {
-                got_tail = true;
-                break;
+        // quotes are counted afresh for each MAX_TOKEN_SIZE - 1 characters, as they always were
+        const char *start = p;
+        while (true) {
+            const char *chunk = p;
+            const char *stop = end - chunk > MAX_TOKEN_SIZE - 1 ? chunk + MAX_TOKEN_SIZE - 1 : end;
+            unsigned int tc = 0;
+            for (const char *q = chunk; q < stop; ++q) {
+                if (*q == '\"') tc++;
+                else if (*q == '>' && (tc & 1u) == 0) {
+                    got_tail = true;
+                    value = std::string_view(start, q - start);
+                    p = q + 1;
+                    return TT_DATA;
+                }
             }
+            p = stop;
+            if (stop == end) return TT_EOF;
         }
-        return TT_DATA;
     }
 
 
 }
-
@@ -3,16 +3,16 @@
 //|
 //| (C) Andrew Fedoniouk @ terrainformatica.com
 //|
+//| Works on the input in place: runs of text, comments and the content of
+//| script and style elements are found a block of bytes at a time.
+//|
 
-namespace markup {
-    struct instream {
-        const char *p;
-        const char *end;
-        explicit instream(const char *src) : p(src), end(src+strlen(src)) {}
-        char get_char() { return p < end ? *p++ : 0; }
-    };
+#ifndef WARC2TEXT_XH_SCANNER_HH
+#define WARC2TEXT_XH_SCANNER_HH
 
+#include <string_view>
 
+namespace markup {
     class scanner {
     public:
         enum token_type {
@@ -46,19 +46,21 @@ namespace markup {
 
     public:
 
-        explicit scanner(instream &is) :
-                value_length(0),
+        // scans [begin, end), which holds no NUL and must stay alive while the scanner is used
+        scanner(const char *begin, const char *end) :
+                p(begin),
+                end(end),
+                c_scan(reader::body),
                 tag_name_length(0),
                 attr_name_length(0),
-                input(is),
-                input_char(0),
-                got_tail(false) { c_scan = &scanner::scan_body; }
+                got_tail(false) {}
 
         // get next token
-        token_type get_token() { return (this->*c_scan)(); }
+        token_type get_token();
 
-        // get value of TT_WORD, TT_SPACE, TT_ATTR and TT_DATA
-        const char *get_value();
+        // get value of TT_WORD, TT_SPACE, TT_ATTR and TT_DATA, a view into the input.
+        // Words, spaces and attribute values are cut at MAX_TOKEN_SIZE - 1 characters.
+        std::string_view get_value() const { return value; }
 
         // get attribute name
         const char *get_attr_name();
@@ -68,9 +70,7 @@ namespace markup {
 
     private: /* methods */
 
-        typedef token_type (scanner::*scan)();
-
-        scan c_scan; // current 'reader'
+        enum class reader { body, head, comment, cdata, special, entity_decl };
 
         // content 'readers'
         token_type scan_body();
@@ -83,21 +83,20 @@ namespace markup {
 
         token_type scan_special();
 
-        token_type scan_pi();
-
         token_type scan_tag();
 
         token_type scan_entity_decl();
 
-        char skip_whitespace();
+        // content of a comment or CDATA section up to the tail made of two marks and '>'
+        token_type scan_until_tail(char mark);
 
-        void push_back(char c);
+        char skip_whitespace();
 
-        char get_char();
+        void push_back(char c) { if (c) --p; }
 
-        static bool is_whitespace(char c);
+        char get_char() { return p < end ? *p++ : 0; }
 
-        void append_value(char c);
+        void set_value(const char *begin, const char *stop);
 
         void append_attr_name(char c);
 
@@ -105,8 +104,12 @@ namespace markup {
 
     private: /* data */
 
-        char value[MAX_TOKEN_SIZE]{};
-        unsigned int value_length;
+        const char *p; // next character to read
+        const char *end;
+
+        reader c_scan; // current 'reader'
+
+        std::string_view value;
 
         char tag_name[MAX_NAME_SIZE]{};
         unsigned int tag_name_length;
@@ -114,10 +117,9 @@ namespace markup {
         char attr_name[MAX_NAME_SIZE]{};
         unsigned int attr_name_length;
 
-        instream &input;
-        char input_char;
-
         bool got_tail; // aux flag used in scan_comment, etc.
 
     };
 }
+
+#endif
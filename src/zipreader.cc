@@ -3,22 +3,34 @@
 
 namespace util {
 
-ZipReader::ZipReader(const std::string &payload)
+ZipReader::ZipReader(std::string_view payload)
 : src_(nullptr, &zip_source_free), archive_() {
     zip_error_t error{};
 
     src_.reset(zip_source_buffer_create(const_cast<void*>(static_cast<const void*>(payload.data())), payload.size(), 0, &error));
-    if (!src_)
-        throw ZipReadError(&error);
+    if (!src_) {
+        error_ = zip_error_strerror(&error);
+        return;
+    }
 
     zip_source_keep(src_.get());
 
     archive_.reset(zip_open_from_source(src_.get(), 0, &error), zip_discard);
     if (!archive_)
-        throw ZipReadError(&error);
+        error_ = zip_error_strerror(&error);
+}
+
+bool ZipReader::valid() const {
+    return archive_ != nullptr;
+}
+
+const std::string& ZipReader::error() const {
+    return error_;
 }
 
 size_t ZipReader::size() const {
+    if (!archive_)
+        return 0;
     zip_int64_t num_entries = zip_get_num_entries(archive_.get(), 0);
     return num_entries;
 }
@@ -44,7 +56,7 @@ size_t ZipEntry::size() const {
     return st.size;
 }
 
-std::string ZipEntry::read(std::string &&buffer) const {
+bool ZipEntry::read(std::string &buffer, std::string &error) const {
     // Remove any lingering error state from previous reads
     zip_error_clear(archive_.get());
 
@@ -55,8 +67,10 @@ std::string ZipEntry::read(std::string &&buffer) const {
 
     // Open pointer to file inside zip
     std::unique_ptr<zip_file_t, decltype(&zip_fclose)> fh(zip_fopen_index(archive_.get(), index_, 0), &zip_fclose);
-    if (!fh)
-        throw ZipReadError(zip_get_error(archive_.get()));
+    if (!fh) {
+        error = zip_error_strerror(zip_get_error(archive_.get()));
+        return false;
+    }
 
     // Make room for uncompressed data
     buffer.resize(st.size);
@@ -65,8 +79,10 @@ std::string ZipEntry::read(std::string &&buffer) const {
     for (size_t read = 0; read < buffer.size();) {
         auto len = zip_fread(fh.get(), &buffer[0] + read, buffer.size() - read);
 
-        if (len == -1)
-            throw ZipReadError(zip_get_error(archive_.get()));
+        if (len == -1) {
+            error = zip_error_strerror(zip_get_error(archive_.get()));
+            return false;
+        }
 
         read += len;
     }
@@ -77,14 +93,12 @@ std::string ZipEntry::read(std::string &&buffer) const {
     // Check CRC checksum
     boost::crc_32_type crc;
     crc.process_bytes(buffer.data(), buffer.size());
-    if (crc.checksum() != st.crc)
-        throw ZipReadError("bad CRC");
-
-    return std::move(buffer);
-}
+    if (crc.checksum() != st.crc) {
+        error = "bad CRC";
+        return false;
+    }
 
-std::string ZipEntry::read() const {
-    return read(std::string());
+    return true;
 }
 
 } // end namespace
@@ -1,21 +1,10 @@
-#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <zip.h>
 
 namespace util {
 
-class ZipReadError : public std::runtime_error {
-public:
-    ZipReadError(std::string const &error) : runtime_error(error) {
-        //
-    }
-
-    ZipReadError(zip_error_t *error) : runtime_error(zip_error_strerror(error)) {
-        //
-    }
-};
-
 class ZipEntry {
 private:
     std::shared_ptr<zip_t> archive_;
@@ -26,8 +15,8 @@ public:
     size_t index() const;
     std::string name() const;
     size_t size() const;
-    std::string read(std::string &&buffer) const;
-    std::string read() const;
+    // reads the file into buffer, false if that failed and error says why
+    bool read(std::string &buffer, std::string &error) const;
 
     friend bool operator==(const ZipEntry& a, const ZipEntry& b) {
         return a.archive_ == b.archive_ && a.index_ == b.index_;
@@ -91,20 +80,26 @@ public:
  * Example:
  *
  *   ZipReader reader(buffer);
- *   for (auto file : reader)
- *     if (file.name() == "something.txt")
- *       std::cerr << file.read();
+ *   if (reader.valid())
+ *     for (auto file : reader)
+ *       if (file.name() == "something.txt" && file.read(content, error))
+ *         std::cerr << content;
  *
  */
 class ZipReader {
 private:
     std::unique_ptr<zip_source_t, decltype(&zip_source_free)> src_;
     std::shared_ptr<zip_t> archive_;
+    std::string error_;
 
 public:
     typedef ZipEntryIterator const_iterator;
 
-    ZipReader(const std::string &payload);
+    ZipReader(std::string_view payload);
+
+    // whether payload could be opened as a zip archive, if not error() says why
+    bool valid() const;
+    const std::string& error() const;
 
     size_t size() const;
 
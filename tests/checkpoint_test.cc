@@ -0,0 +1,75 @@
+#define BOOST_TEST_MODULE checkpoint
+#include <boost/test/unit_test.hpp>
+
+#include "src/checkpoint.hh"
+#include "test_util.hh"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace warc2text {
+namespace {
+
+using test::TempFile;
+
+BOOST_AUTO_TEST_CASE(missing_ledger) {
+    TempFile file;
+    std::remove(file.name.c_str());
+    CheckpointLedger ledger;
+    BOOST_CHECK(!ledger.load(file.name));
+    BOOST_CHECK(!ledger.isDone("a.warc.gz"));
+    BOOST_CHECK_EQUAL(ledger.resumeOffset("a.warc.gz"), 0);
+}
+
+BOOST_AUTO_TEST_CASE(round_trip) {
+    TempFile file;
+    CheckpointLedger ledger;
+    ledger.inputs["a.warc.gz"] = InputProgress{12345, false};
+    ledger.inputs["b.warc.gz"] = InputProgress{6000000000, true};
+    ledger.outputs["out/en/text.gz"] = 4096;
+    ledger.outputs["out/fr/url.gz"] = 0;
+    ledger.save(file.name);
+
+    // the tmp file was renamed over the ledger
+    BOOST_CHECK(!std::ifstream(file.name + ".tmp"));
+
+    CheckpointLedger loaded;
+    loaded.inputs["stale.warc.gz"] = InputProgress{1, true};
+    BOOST_REQUIRE(loaded.load(file.name));
+    BOOST_CHECK_EQUAL(loaded.inputs.size(), 2);
+    BOOST_CHECK_EQUAL(loaded.resumeOffset("a.warc.gz"), 12345);
+    BOOST_CHECK(!loaded.isDone("a.warc.gz"));
+    BOOST_CHECK_EQUAL(loaded.resumeOffset("b.warc.gz"), 6000000000);
+    BOOST_CHECK(loaded.isDone("b.warc.gz"));
+    BOOST_CHECK(!loaded.isDone("stale.warc.gz"));
+    BOOST_CHECK_EQUAL(loaded.resumeOffset("c.warc.gz"), 0);
+    BOOST_REQUIRE_EQUAL(loaded.outputs.size(), 2);
+    BOOST_CHECK_EQUAL(loaded.outputs["out/en/text.gz"], 4096);
+    BOOST_CHECK_EQUAL(loaded.outputs["out/fr/url.gz"], 0);
+}
+
+BOOST_AUTO_TEST_CASE(save_replaces_ledger) {
+    TempFile file;
+    CheckpointLedger ledger;
+    ledger.inputs["a.warc.gz"] = InputProgress{100, false};
+    ledger.save(file.name);
+    ledger.inputs["a.warc.gz"] = InputProgress{200, true};
+    ledger.save(file.name);
+
+    CheckpointLedger loaded;
+    BOOST_REQUIRE(loaded.load(file.name));
+    BOOST_CHECK_EQUAL(loaded.resumeOffset("a.warc.gz"), 200);
+    BOOST_CHECK(loaded.isDone("a.warc.gz"));
+}
+
+BOOST_AUTO_TEST_CASE(invalid_ledger) {
+    TempFile file;
+    CheckpointLedger ledger;
+    std::ofstream(file.name) << "{\"inputs\": {\"a.warc.gz\": {\"offset\": -1, \"done\": false}}, \"outputs\": {}}\n";
+    BOOST_CHECK_THROW(ledger.load(file.name), CheckpointFileException);
+    std::ofstream(file.name) << "{\"inputs\": {}\n";
+    BOOST_CHECK_THROW(ledger.load(file.name), CheckpointFileException);
+}
+
+} // namespace
+} // namespace warc2text
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# Writes html.warc.gz, HTML documents for xh_scanner_test: pages made of the markup the
+# scanner treats differently, and runs of comments, CDATA sections, scripts and styles whose
+# ends fall on every position around the 1023 character reads the scanner used to make.
+import gzip
+import random
+
+rng = random.Random(2024)
+
+words = ["the", "scanner", "reads", "words", "café", "straße", "日本語", "русский",
+         "a&amp;b", "&lt;tag&gt;", "&nbsp;", "&#169;", "x<y", "1>0", "&", "'quoted'", "\"double\""]
+
+
+def text(n):
+    return " ".join(rng.choice(words) for _ in range(n))
+
+
+def script_body(n):
+    body = ""
+    while len(body) < n:
+        body += rng.choice(["if (a < b && c > d) { x = '</scr' + 'ipt>'; }\n", "var s = \"<p>not a tag</p>\";\n",
+                            "// </style> is not the end\n", "for (i = 0; i<n; i++) f(i);\n", "a = b --> c;\n"])
+    return body[:n]
+
+
+pieces = [
+    lambda: "<p>" + text(rng.randint(1, 40)) + "</p>\n",
+    lambda: "<a href=\"http://example.com/%d\" title='t %d'>%s</a>" % (rng.randint(0, 99), rng.randint(0, 9), text(3)),
+    # unquoted values, which lose their first character
+    lambda: "<td align=center valign = top width=%d>%s</td>" % (rng.randint(1, 999), text(2)),
+    lambda: "<a href=http://example.com/unquoted>%s</a>" % text(2),
+    lambda: "<input type=checkbox disabled checked><br/><hr />",
+    lambda: "<img src=\"a.png\" alt=\"%s\">" % text(4),
+    lambda: "<!-- %s -->" % text(rng.randint(0, 30)),
+    lambda: "<!--" + "-" * rng.randint(0, 3) + text(5) + "- -> --!>" + "-->",
+    lambda: "<![CDATA[ %s ]] > ]]>" % text(10),
+    lambda: "<script type=\"text/javascript\">" + script_body(rng.randint(0, 3000)) + "</script>",
+    lambda: "<SCRIPT>" + script_body(rng.randint(0, 200)) + "</SCRIPT>",
+    lambda: "<style>p { color: red; } a > b { x: y }" + "x" * rng.randint(0, 2000) + "</style>",
+    lambda: "<?xml version=\"1.0\"?><!DOCTYPE html>",
+    lambda: "<!ENTITY name \"a > b\" 'c'>",
+    lambda: "<div class=\"c%d\" id=d%d data-x=\"%s\">" % (rng.randint(0, 9), rng.randint(0, 9), "v" * rng.randint(0, 1100)),
+    lambda: "</div>",
+    lambda: "word" * rng.randint(200, 300),
+    lambda: " \t\n\r\f" * rng.randint(1, 300),
+    lambda: "<" + "n" * rng.randint(100, 140) + " " + "a" * rng.randint(100, 140) + "=1>",
+    lambda: "<> </> <script></script><> < p> </ p>",
+    lambda: "<i/ > a / > b",
+]
+
+
+def page():
+    body = "".join(rng.choice(pieces)() for _ in range(rng.randint(5, 60)))
+    doc = "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>%s</title></head><body>%s</body></html>\n" % (text(4), body)
+    # some end in the middle of something
+    if rng.random() < 0.2:
+        doc = doc[:rng.randint(0, len(doc))]
+    return doc
+
+
+def sweep(open_tag, close_tag, fill):
+    return "".join(open_tag + fill * n + close_tag + "\n" for n in range(1000, 1060))
+
+
+documents = [page() for _ in range(150)]
+documents.append(sweep("<!--", "-->", "c"))
+documents.append(sweep("<!--", "-->", "-"))
+documents.append(sweep("<![CDATA[", "]]>", "d"))
+documents.append(sweep("<script>", "</script>", "s"))
+documents.append(sweep("<style>", "</style>", "<"))
+documents.append(sweep("<script>", "</script>", "a<b "))
+documents.append(sweep("<!ENTITY ", ">", "\""))
+documents.append("<script>" + script_body(5000))
+documents.append("<!--" + "c" * 5000)
+
+with open("html.warc.gz", "wb") as warc:
+    for i, doc in enumerate(documents):
+        payload = doc.encode("utf-8")
+        block = b"HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: %d\r\n\r\n" % len(payload) + payload
+        header = ("WARC/1.0\r\nWARC-Type: response\r\nWARC-Target-URI: http://example.com/%d.html\r\n"
+                  "WARC-Date: 2024-01-01T00:00:00Z\r\nWARC-Record-ID: <urn:uuid:00000000-0000-0000-0000-%012d>\r\n"
+                  "Content-Type: application/http; msgtype=response\r\nContent-Length: %d\r\n\r\n") % (i, i, len(block))
+        warc.write(gzip.compress(header.encode() + block + b"\r\n\r\n", mtime=0))
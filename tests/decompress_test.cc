@@ -0,0 +1,142 @@
+#define BOOST_TEST_MODULE decompress
+#include <boost/test/unit_test.hpp>
+
+#include "src/decompress.hh"
+#include "test_util.hh"
+#include <cstdint>
+#include <string>
+
+namespace warc2text {
+namespace {
+
+using test::compress;
+
+const int gzip_bits = 16 + MAX_WBITS;
+const std::size_t no_limit = static_cast<std::size_t>(-1);
+
+std::string sample(std::size_t size) {
+    std::string text;
+    for (std::size_t i = 0; text.size() < size; ++i)
+        text.append("line ").append(std::to_string(i * 7919 % 10007)).append(" of the payload\n");
+    text.resize(size);
+    return text;
+}
+
+BOOST_AUTO_TEST_CASE(decode_gzip) {
+    std::string text = sample(100000), decoded;
+    BOOST_CHECK(decodeContent(compress(text, gzip_bits), "gzip", decoded, no_limit) == DecodeStatus::ok);
+    BOOST_CHECK(decoded == text);
+    BOOST_CHECK(decodeContent(compress(text, gzip_bits), "x-gzip", decoded, text.size()) == DecodeStatus::ok);
+    BOOST_CHECK(decoded == text);
+    // members one after the other
+    BOOST_CHECK(decodeContent(compress("one ", gzip_bits) + compress("two", gzip_bits), "gzip", decoded, no_limit) == DecodeStatus::ok);
+    BOOST_CHECK_EQUAL(decoded, "one two");
+    BOOST_CHECK(decodeContent(compress("", gzip_bits), "gzip", decoded, no_limit) == DecodeStatus::ok);
+    BOOST_CHECK_EQUAL(decoded, "");
+}
+
+BOOST_AUTO_TEST_CASE(decode_gzip_wrong_trailer) {
+    // a trailer that does not match is an error, and a huge one does not size the output
+    std::string text = sample(50000), decoded;
+    std::string payload = compress(text, gzip_bits);
+    payload.replace(payload.size() - 4, 4, "\xff\xff\xff\xff");
+    BOOST_CHECK(decodeContent(payload, "gzip", decoded, no_limit) == DecodeStatus::corrupt);
+    payload.replace(payload.size() - 4, 4, std::string(4, '\0'));
+    BOOST_CHECK(decodeContent(payload, "gzip", decoded, no_limit) == DecodeStatus::corrupt);
+}
+
+BOOST_AUTO_TEST_CASE(decode_gzip_bomb) {
+    // 256 MB of zeros compress to about 250 KB
+    std::string payload = compress(std::string(256 << 20, '\0'), gzip_bits);
+    BOOST_REQUIRE_LT(payload.size(), 1 << 20);
+    std::string decoded;
+    BOOST_CHECK(decodeContent(payload, "gzip", decoded, 1 << 20) == DecodeStatus::too_large);
+    BOOST_CHECK_LE(decoded.size(), (1 << 20) + 1);
+    BOOST_CHECK_LE(decoded.capacity(), 2 << 20);
+    BOOST_CHECK(decodeContent(compress(std::string(1000, 'a'), MAX_WBITS), "deflate", decoded, 999) == DecodeStatus::too_large);
+    // exactly the maximum is not too large
+    BOOST_CHECK(decodeContent(compress(std::string(1000, 'a'), gzip_bits), "gzip", decoded, 1000) == DecodeStatus::ok);
+    BOOST_CHECK_EQUAL(decoded.size(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(decode_truncated) {
+    // a payload cut short decodes to as much as there is of it
+    std::string text = sample(100000), decoded;
+    std::string payload = compress(text, gzip_bits);
+    BOOST_CHECK(decodeContent(payload.substr(0, payload.size() / 2), "gzip", decoded, no_limit) == DecodeStatus::ok);
+    BOOST_CHECK_GT(decoded.size(), 0);
+    BOOST_CHECK_LT(decoded.size(), text.size());
+    BOOST_CHECK(text.compare(0, decoded.size(), decoded) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(decode_deflate) {
+    std::string text = sample(20000), decoded;
+    // zlib wrapped as the specification says, or raw as servers send it
+    BOOST_CHECK(decodeContent(compress(text, MAX_WBITS), "deflate", decoded, no_limit) == DecodeStatus::ok);
+    BOOST_CHECK(decoded == text);
+    BOOST_CHECK(decodeContent(compress(text, -MAX_WBITS), "deflate", decoded, no_limit) == DecodeStatus::ok);
+    BOOST_CHECK(decoded == text);
+}
+
+BOOST_AUTO_TEST_CASE(decode_errors) {
+    std::string decoded;
+    BOOST_CHECK(decodeContent("not compressed at all", "gzip", decoded, no_limit) == DecodeStatus::corrupt);
+    BOOST_CHECK(decodeContent("\xff\xff\xff\xff", "deflate", decoded, no_limit) == DecodeStatus::corrupt);
+    BOOST_CHECK(decodeContent(compress("text", gzip_bits), "compress", decoded, no_limit) == DecodeStatus::unsupported);
+    BOOST_CHECK(decodeContent("text", "identity", decoded, no_limit) == DecodeStatus::unsupported);
+}
+
+std::string dechunked(std::string input, DechunkStatus expected) {
+    BOOST_CHECK_EQUAL(describe(dechunk(input)), describe(expected));
+    return input;
+}
+
+BOOST_AUTO_TEST_CASE(dechunk_chunks) {
+    BOOST_CHECK_EQUAL(dechunked("4\r\nWiki\r\n5\r\npedia\r\n0\r\n\r\n", DechunkStatus::ok), "Wikipedia\r\n");
+    // extensions, spaces around the size, upper case hex
+    BOOST_CHECK_EQUAL(dechunked("4;name=value\r\nWiki\r\n 5 \t;x\r\npedia\r\nA\r\n0123456789\r\n0\r\n\r\n", DechunkStatus::ok),
+                      "Wikipedia0123456789\r\n");
+    // what follows the last chunk is kept
+    BOOST_CHECK_EQUAL(dechunked("4\r\nWiki\r\n0\r\nX-Trailer: a\r\n\r\n", DechunkStatus::ok), "WikiX-Trailer: a\r\n\r\n");
+    // no last chunk
+    BOOST_CHECK_EQUAL(dechunked("4\r\nWiki\r\n", DechunkStatus::ok), "Wiki");
+    BOOST_CHECK_EQUAL(dechunked("", DechunkStatus::ok), "");
+}
+
+BOOST_AUTO_TEST_CASE(dechunk_many_chunks) {
+    std::string input, expected;
+    for (int i = 0; i < 10000; ++i) {
+        input.append("1\r\n").append(1, 'a' + i % 26).append("\r\n");
+        expected.append(1, 'a' + i % 26);
+    }
+    input.append("0\r\n");
+    BOOST_CHECK(dechunked(input, DechunkStatus::ok) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(dechunk_bad_chunk_size) {
+    // not hexadecimal: the chunks before it are dechunked and the rest is left as it was
+    BOOST_CHECK_EQUAL(dechunked("4\r\nWiki\r\nxyz\r\nmore", DechunkStatus::bad_chunk_size), "Wikixyz\r\nmore");
+    BOOST_CHECK_EQUAL(dechunked("4 x\r\nWiki\r\n", DechunkStatus::bad_chunk_size), "4 x\r\nWiki\r\n");
+    BOOST_CHECK_EQUAL(dechunked("-4\r\nWiki\r\n", DechunkStatus::bad_chunk_size), "-4\r\nWiki\r\n");
+    BOOST_CHECK_EQUAL(dechunked(";ext\r\nWiki\r\n", DechunkStatus::bad_chunk_size), ";ext\r\nWiki\r\n");
+    BOOST_CHECK_EQUAL(dechunked("\r\nWiki", DechunkStatus::bad_chunk_size), "\r\nWiki");
+    BOOST_CHECK_EQUAL(dechunked("<html>", DechunkStatus::bad_chunk_size), "<html>");
+}
+
+BOOST_AUTO_TEST_CASE(dechunk_chunk_too_long) {
+    BOOST_CHECK_EQUAL(dechunked("10\r\nshort\r\n", DechunkStatus::chunk_too_long), "short\r\n");
+    BOOST_CHECK_EQUAL(dechunked("4\r\nWiki", DechunkStatus::chunk_too_long), "Wiki");
+    // a size that does not fit in size_t does not wrap around to a small one
+    BOOST_CHECK_EQUAL(dechunked("ffffffffffffffffffffffff\r\nab\r\n", DechunkStatus::chunk_too_long), "ab\r\n");
+    BOOST_CHECK_EQUAL(dechunked("10000000000000002\r\nab\r\n", DechunkStatus::chunk_too_long), "ab\r\n");
+    // a size line that does not end
+    BOOST_CHECK_EQUAL(dechunked("1;" + std::string(100000, 'e'), DechunkStatus::chunk_too_long), "");
+}
+
+BOOST_AUTO_TEST_CASE(dechunk_missing_crlf) {
+    BOOST_CHECK_EQUAL(dechunked("4\r\nWikiX\r\n0\r\n", DechunkStatus::missing_crlf), "WikiX\r\n0\r\n");
+    BOOST_CHECK_EQUAL(dechunked("2\r\nab\r\n4\r\nWiki\n\n", DechunkStatus::missing_crlf), "abWiki\n\n");
+}
+
+} // namespace
+} // namespace warc2text
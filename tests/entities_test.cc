@@ -0,0 +1,46 @@
+#define BOOST_TEST_MODULE entities
+#include <boost/test/unit_test.hpp>
+
+#include "src/entities.hh"
+#include <string>
+
+namespace warc2text {
+namespace {
+
+std::string decode(const std::string& source) {
+    std::string target;
+    entities::decodeEntities(source, target);
+    return target;
+}
+
+BOOST_AUTO_TEST_CASE(numeric_entities) {
+    BOOST_CHECK_EQUAL(decode("&#65;&#x42;&#X43;"), "ABC");
+    BOOST_CHECK_EQUAL(decode("&#x10FFFF;"), "\xF4\x8F\xBF\xBF");
+    BOOST_CHECK_EQUAL(decode("&amp;&lt;"), "&<");
+}
+
+BOOST_AUTO_TEST_CASE(malformed_numeric_entities) {
+    // past U+10FFFF, and too large for any integer, the entity is left out
+    BOOST_CHECK_EQUAL(decode("a&#1114112;b"), "ab");
+    BOOST_CHECK_EQUAL(decode("a&#x110000;b"), "ab");
+    BOOST_CHECK_EQUAL(decode("a&#99999999999999999999999;b"), "ab");
+    BOOST_CHECK_EQUAL(decode("a&#xFFFFFFFFFFFFFFFFFFFF;b"), "ab");
+    // without digits only the ; is left
+    BOOST_CHECK_EQUAL(decode("a&#;b"), "a;b");
+    BOOST_CHECK_EQUAL(decode("a&#x;b"), "a;b");
+    // a character that cannot be in the code ends the entity, which is kept as text
+    BOOST_CHECK_EQUAL(decode("a&#12a;b"), "a&#12a;b");
+    BOOST_CHECK_EQUAL(decode("a&#x4g;b"), "a&#x4g;b");
+    BOOST_CHECK_EQUAL(decode("a&#-5;b"), "a&#-5;b");
+}
+
+BOOST_AUTO_TEST_CASE(unterminated_entities) {
+    BOOST_CHECK_EQUAL(decode("fish &amp chips"), "fish &amp chips");
+    // at the end of the text the rest is kept as it is
+    for (std::string text : {"x &", "x &amp", "x &#", "x &#65", "x &#x", "x &#x41"})
+        BOOST_CHECK_EQUAL(decode(text), text);
+    BOOST_CHECK_EQUAL(decode("&lt;b&gt; &amp"), "<b> &amp");
+}
+
+} // namespace
+} // namespace warc2text
@@ -0,0 +1,127 @@
+#define BOOST_TEST_MODULE header
+#include <boost/test/unit_test.hpp>
+
+#include "src/record.hh"
+#include "src/util.hh"
+#include <string>
+#include <string_view>
+
+namespace warc2text {
+namespace {
+
+BOOST_AUTO_TEST_CASE(header_end) {
+    BOOST_CHECK_EQUAL(util::findHeaderEnd("WARC/1.0\r\nA: b\r\n\r\nbody"), 18);
+    BOOST_CHECK_EQUAL(util::findHeaderEnd("WARC/1.0\nA: b\n\nbody"), 15);
+    // mixed line ends, the way read_header takes them
+    BOOST_CHECK_EQUAL(util::findHeaderEnd("WARC/1.0\r\nA: b\r\n\nbody"), 17);
+    BOOST_CHECK_EQUAL(util::findHeaderEnd("WARC/1.0\nA: b\n\r\nbody"), 16);
+    // not there yet
+    BOOST_CHECK_EQUAL(util::findHeaderEnd("WARC/1.0\r\nA: b\r\n\r"), std::string_view::npos);
+    BOOST_CHECK_EQUAL(util::findHeaderEnd("WARC/1.0\r\nA: b\r\n"), std::string_view::npos);
+    BOOST_CHECK_EQUAL(util::findHeaderEnd(""), std::string_view::npos);
+    // from a position on, as readers do with the part they searched already
+    std::string_view header = "WARC/1.0\n\nA: b\n\nbody";
+    BOOST_CHECK_EQUAL(util::findHeaderEnd(header), 10);
+    BOOST_CHECK_EQUAL(util::findHeaderEnd(header, 10), 16);
+}
+
+BOOST_AUTO_TEST_CASE(version_line) {
+    BOOST_CHECK_EQUAL(read_version_line("WARC/1.0\r\nWARC-Type: response\r\n"), 10);
+    BOOST_CHECK_EQUAL(read_version_line("WARC/1.0\nWARC-Type: response\n"), 9);
+    BOOST_CHECK_EQUAL(read_version_line("WARC/1.0 \r\n"), std::string_view::npos);
+    BOOST_CHECK_EQUAL(read_version_line("WARC/1.1\r\n"), std::string_view::npos);
+    BOOST_CHECK_EQUAL(read_version_line("WARC/1.0"), std::string_view::npos);
+    BOOST_CHECK_EQUAL(read_version_line("HTTP/1.1 200 OK\r\n"), std::string_view::npos);
+}
+
+BOOST_AUTO_TEST_CASE(table_fields) {
+    HeaderTable header;
+    header.set("content-TYPE", "text/html");
+    header.set("X-Custom", "one");
+    header.set("x-custom", "two");
+    BOOST_CHECK(header.has(HeaderTable::content_type));
+    BOOST_CHECK_EQUAL(header.get(HeaderTable::content_type), "text/html");
+    BOOST_REQUIRE(header.find("Content-Type"));
+    BOOST_CHECK_EQUAL(*header.find("Content-Type"), "text/html");
+    BOOST_REQUIRE(header.find("X-CUSTOM"));
+    BOOST_CHECK_EQUAL(*header.find("X-CUSTOM"), "two");
+    BOOST_CHECK(!header.has(HeaderTable::content_length));
+    BOOST_CHECK(!header.find("Content-Length"));
+    BOOST_CHECK(!header.find("X-Other"));
+
+    header.clear();
+    BOOST_CHECK(!header.has(HeaderTable::content_type));
+    BOOST_CHECK(!header.find("X-Custom"));
+    // nothing to continue after clearing
+    header.fold("lost");
+    BOOST_CHECK(!header.find("X-Custom"));
+}
+
+BOOST_AUTO_TEST_CASE(crlf_header) {
+    std::string_view content =
+        "WARC/1.0\r\n"
+        "WARC-Type: response\r\n"
+        "Content-Length:   42\r\n"
+        "not a field\r\n"
+        "\r\n"
+        "payload";
+    HeaderTable header;
+    std::size_t end = read_header(content, read_version_line(content), header);
+    BOOST_CHECK_EQUAL(end, content.size() - 7);
+    BOOST_CHECK_EQUAL(header.get(HeaderTable::warc_type), "response");
+    BOOST_CHECK_EQUAL(header.get(HeaderTable::content_length), "42");
+}
+
+BOOST_AUTO_TEST_CASE(bare_lf_header) {
+    std::string_view content =
+        "HTTP/1.1 200 OK\n"
+        "Content-Type: text/html\n"
+        "Transfer-Encoding:chunked\n"
+        "\n"
+        "payload";
+    HeaderTable header;
+    std::size_t end = read_header(content, content.find('\n') + 1, header);
+    BOOST_CHECK_EQUAL(end, content.size() - 7);
+    BOOST_CHECK_EQUAL(header.get(HeaderTable::content_type), "text/html");
+    BOOST_CHECK_EQUAL(header.get(HeaderTable::transfer_encoding), "chunked");
+    BOOST_CHECK_EQUAL(end, util::findHeaderEnd(content));
+}
+
+BOOST_AUTO_TEST_CASE(folded_header) {
+    std::string_view content =
+        "WARC/1.0\r\n"
+        "Content-Type: application/http;\r\n"
+        "\t msgtype=response\r\n"
+        "X-Long: one\n"
+        " two\n"
+        "  three\r\n"
+        "WARC-Type: response\r\n"
+        "\r\n";
+    HeaderTable header;
+    BOOST_CHECK_EQUAL(read_header(content, read_version_line(content), header), content.size());
+    BOOST_CHECK_EQUAL(header.get(HeaderTable::content_type), "application/http; msgtype=response");
+    BOOST_REQUIRE(header.find("x-long"));
+    BOOST_CHECK_EQUAL(*header.find("x-long"), "one two three");
+    BOOST_CHECK_EQUAL(header.get(HeaderTable::warc_type), "response");
+}
+
+BOOST_AUTO_TEST_CASE(unterminated_header) {
+    HeaderTable header;
+    BOOST_CHECK_EQUAL(read_header("WARC/1.0\r\nWARC-Type: response\r\n", 10, header), std::string_view::npos);
+    BOOST_CHECK_EQUAL(read_header("WARC/1.0\r\nWARC-Type: response", 10, header), std::string_view::npos);
+}
+
+BOOST_AUTO_TEST_CASE(record_header) {
+    RecordHeader lf("WARC/1.0\nWARC-Type: Response\nWARC-Target-URI: <http://example.com/>\n"
+                    "Content-Type: Application/HTTP\n\n");
+    BOOST_CHECK(lf.isValid());
+    BOOST_CHECK_EQUAL(lf.getRecordType(), "response");
+    BOOST_CHECK_EQUAL(lf.getURL(), "http://example.com/");
+    BOOST_CHECK_EQUAL(lf.getWARCcontentType(), "application/http");
+
+    BOOST_CHECK(!RecordHeader("WARC/1.0\r\nWARC-Type: response\r\n").isValid());
+    BOOST_CHECK(!RecordHeader("GARBAGE\r\n\r\n").isValid());
+}
+
+} // namespace
+} // namespace warc2text
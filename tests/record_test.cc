@@ -0,0 +1,184 @@
+#define BOOST_TEST_MODULE record
+#include <boost/test/unit_test.hpp>
+
+#include "src/record.hh"
+#include "src/zipreader.hh"
+#include "test_util.hh"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace warc2text {
+namespace {
+
+const std::string filename = "one.warc.gz";
+
+const std::string chunked_response =
+    "WARC/1.0\r\n"
+    "WARC-Type: response\r\n"
+    "WARC-Target-URI: <http://example.com/chunked>\r\n"
+    "WARC-Date: 2024-01-01T00:00:00Z\r\n"
+    "Content-Type: application/http; msgtype=response\r\n"
+    "\r\n"
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/html; charset=ISO-8859-1\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n"
+    "f\r\n<html><body><p>\r\n"
+    "f\r\nCoffee au lait.\r\n"
+    "12\r\n</p></body></html>\r\n"
+    "0\r\n\r\n"
+    "\r\n\r\n";
+
+const std::string resource =
+    "WARC/1.0\n"
+    "WARC-Type: resource\n"
+    "WARC-Target-URI: http://example.com/notes.txt\n"
+    "Content-Type: text/plain\n"
+    "\n"
+    "Plain notes.\n"
+    "\r\n\r\n";
+
+// every field reset should have forgotten, compared with a record read fresh
+void checkSame(const Record& reused, const Record& fresh) {
+    BOOST_CHECK_EQUAL(reused.getURL(), fresh.getURL());
+    BOOST_CHECK_EQUAL(reused.getRecordType(), fresh.getRecordType());
+    BOOST_CHECK_EQUAL(reused.getWARCcontentType(), fresh.getWARCcontentType());
+    BOOST_CHECK_EQUAL(reused.getWARCdate(), fresh.getWARCdate());
+    BOOST_CHECK_EQUAL(reused.getHTTPcontentType(), fresh.getHTTPcontentType());
+    BOOST_CHECK_EQUAL(reused.getCharset(), fresh.getCharset());
+    BOOST_CHECK_EQUAL(reused.getPayload(), fresh.getPayload());
+    BOOST_CHECK_EQUAL(reused.getPlainText(), fresh.getPlainText());
+    BOOST_CHECK_EQUAL(reused.HTTPheaderExists("status"), fresh.HTTPheaderExists("status"));
+    BOOST_CHECK_EQUAL(reused.HTTPheaderExists("content-type"), fresh.HTTPheaderExists("content-type"));
+    BOOST_CHECK_EQUAL(reused.getHeaderProperty("WARC-Date"), fresh.getHeaderProperty("WARC-Date"));
+    BOOST_CHECK_EQUAL(reused.getTextByLangs().size(), fresh.getTextByLangs().size());
+    BOOST_CHECK_EQUAL(reused.getFilename(), fresh.getFilename());
+    BOOST_CHECK_EQUAL(reused.getSize(), fresh.getSize());
+    BOOST_CHECK_EQUAL(reused.getOffset(), fresh.getOffset());
+}
+
+BOOST_AUTO_TEST_CASE(parse_response) {
+    Record record(chunked_response, filename, 300, 0);
+    BOOST_CHECK_EQUAL(record.getURL(), "http://example.com/chunked");
+    BOOST_CHECK_EQUAL(record.getRecordType(), "response");
+    BOOST_CHECK_EQUAL(record.getWARCdate(), "2024-01-01T00:00:00Z");
+    BOOST_CHECK_EQUAL(record.getHTTPcontentType(), "text/html");
+    BOOST_CHECK_EQUAL(record.getCharset(), "ISO-8859-1");
+    BOOST_CHECK_EQUAL(record.getHTTPheaderProperty("status"), "200 OK");
+
+    record.decodePayload();
+    BOOST_CHECK_EQUAL(record.getPayload(), "<html><body><p>Coffee au lait.</p></body></html>");
+    BOOST_CHECK_EQUAL(record.cleanPayload(false), util::SUCCESS);
+    BOOST_CHECK_EQUAL(record.getPlainText(), "Coffee au lait.\n");
+}
+
+BOOST_AUTO_TEST_CASE(reset_forgets_record) {
+    Record reused(chunked_response, filename, 300, 0);
+    reused.decodePayload();
+    BOOST_CHECK_EQUAL(reused.cleanPayload(false), util::SUCCESS);
+
+    const std::string other_filename = "two.warc.gz";
+    reused.reset(resource, other_filename, 120, 300);
+    Record fresh(resource, other_filename, 120, 300);
+    checkSame(reused, fresh);
+    BOOST_CHECK_EQUAL(reused.getRecordType(), "resource");
+    BOOST_CHECK_EQUAL(reused.getPayload(), "Plain notes.");
+    BOOST_CHECK(!reused.HTTPheaderExists("status"));
+    BOOST_CHECK(reused.getHTTPcontentType().empty());
+    BOOST_CHECK(reused.getCharset().empty());
+
+    // and back again, through the buffer it handed back
+    std::string buffer = reused.releaseContent();
+    buffer.assign(chunked_response);
+    reused.reset(std::move(buffer), filename, 300, 0);
+    Record again(chunked_response, filename, 300, 0);
+    checkSame(reused, again);
+    reused.decodePayload();
+    again.decodePayload();
+    checkSame(reused, again);
+}
+
+const std::string docx = "application/vnd.openxmlformats-officedocument.wordprocessingml.document";
+
+std::string le(uint32_t value, int bytes) {
+    std::string out;
+    for (int i = 0; i < bytes; ++i)
+        out.push_back(static_cast<char>(value >> (8 * i) & 0xff));
+    return out;
+}
+
+// zip archive of files stored without compression. The CRC of the file named bad_crc is off by one.
+std::string storedZip(const std::vector<std::pair<std::string, std::string>>& files, const std::string& bad_crc = "") {
+    std::string zip, directory;
+    for (const auto& file : files) {
+        uint32_t crc = crc32(0, reinterpret_cast<const Bytef*>(file.second.data()), file.second.size()) + (file.first == bad_crc);
+        // version needed, flags, method, time, date, crc, sizes, name and extra field lengths
+        std::string fields = le(20, 2) + le(0, 2) + le(0, 2) + le(0, 2) + le(0, 2) + le(crc, 4)
+            + le(file.second.size(), 4) + le(file.second.size(), 4) + le(file.first.size(), 2) + le(0, 2);
+        // version made by, the same fields, comment length, disk, attributes and where the file starts
+        directory += le(0x02014b50, 4) + le(20, 2) + fields + le(0, 2) + le(0, 2) + le(0, 2) + le(0, 4)
+            + le(zip.size(), 4) + file.first;
+        zip += le(0x04034b50, 4) + fields + file.first + file.second;
+    }
+    return zip + directory + le(0x06054b50, 4) + le(0, 4) + le(files.size(), 2) + le(files.size(), 2)
+        + le(directory.size(), 4) + le(zip.size(), 4) + le(0, 2);
+}
+
+BOOST_AUTO_TEST_CASE(read_zip_payload) {
+    const std::string document = "<w:document><w:p>Tea.</w:p></w:document>";
+    std::string zip = storedZip({{"[Content_Types].xml", "<Types/>"}, {"word/document.xml", document}});
+    std::string unzipped, error;
+    BOOST_CHECK(Record::readZipPayload(docx, zip, unzipped, error));
+    BOOST_CHECK_EQUAL(unzipped, document);
+    BOOST_CHECK(error.empty());
+}
+
+BOOST_AUTO_TEST_CASE(read_corrupt_zip_payload) {
+    // not an archive at all, or one cut short: false, and why
+    std::string zip = storedZip({{"word/document.xml", "<w:document/>"}});
+    for (std::string payload : {std::string("PK\x03\x04 and nothing else"), zip.substr(0, zip.size() - 10)}) {
+        std::string unzipped = "left over", error;
+        BOOST_CHECK(!Record::readZipPayload(docx, payload, unzipped, error));
+        BOOST_CHECK(unzipped.empty());
+        BOOST_CHECK_EQUAL(error, "Not a zip archive");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(read_zip_payload_bad_crc) {
+    // a file that does not match its CRC is left out of the text, the archive is still read
+    std::string zip = storedZip({{"word/document.xml", "<w:p>broken</w:p>"}}, "word/document.xml");
+    std::string unzipped, error;
+    BOOST_CHECK(Record::readZipPayload(docx, zip, unzipped, error));
+    BOOST_CHECK(unzipped.empty());
+    // checked by ZipEntry::read, or by libzip itself when it reads past the end of the file
+    BOOST_CHECK_MESSAGE(error == "bad CRC" || error == "CRC error", "error: " << error);
+
+    util::ZipReader reader(zip);
+    BOOST_REQUIRE(reader.valid());
+    BOOST_REQUIRE_EQUAL(reader.size(), 1);
+    std::string content;
+    error.clear();
+    BOOST_CHECK(!reader.begin()->read(content, error));
+    BOOST_CHECK_MESSAGE(error == "bad CRC" || error == "CRC error", "error: " << error);
+}
+
+BOOST_AUTO_TEST_CASE(corrupt_zip_record) {
+    // the record is reported with a status instead of an exception
+    const std::string body = "PK\x03\x04 not really a document";
+    std::string warc =
+        "WARC/1.0\r\n"
+        "WARC-Type: response\r\n"
+        "WARC-Target-URI: http://example.com/report.docx\r\n"
+        "Content-Type: application/http; msgtype=response\r\n"
+        "\r\n"
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: " + docx + "\r\n"
+        "\r\n" + body + "\r\n\r\n";
+    Record record(warc, filename, 200, 0);
+    record.decodePayload();
+    BOOST_CHECK_EQUAL(record.cleanPayload(false), util::ZIP_READ_ERROR);
+}
+
+} // namespace
+} // namespace warc2text
@@ -0,0 +1,47 @@
+#define BOOST_TEST_MODULE recordfilter
+#include <boost/test/unit_test.hpp>
+
+#include "src/recordfilter.hh"
+#include <string>
+#include <unordered_set>
+
+namespace warc2text {
+namespace {
+
+const std::unordered_set<std::string> extensions = {".jpg", ".js", ".gz"};
+
+BOOST_AUTO_TEST_CASE(extension) {
+    BOOST_CHECK(hasExtension("http://example.com/image.jpg", extensions));
+    BOOST_CHECK(hasExtension("http://example.com/a/b.c/script.min.js", extensions));
+    BOOST_CHECK(hasExtension("http://example.com/archive.tar.gz", extensions));
+    // the URL ends in the extension, the way the filter always matched them
+    BOOST_CHECK(hasExtension("http://example.js", extensions));
+
+    BOOST_CHECK(!hasExtension("http://example.com/page.html", extensions));
+    BOOST_CHECK(!hasExtension("http://example.com/", extensions));
+    BOOST_CHECK(!hasExtension("http://example.com/image.jpg/", extensions));
+    BOOST_CHECK(!hasExtension("http://example.com/image.jpg?size=2", extensions));
+    BOOST_CHECK(!hasExtension("http://example.com/image.JPG", extensions));
+    BOOST_CHECK(!hasExtension("http://example.com/image.jpgx", extensions));
+    BOOST_CHECK(!hasExtension("http://example.com/jpg", extensions));
+    BOOST_CHECK(!hasExtension("http://example.com/x.jpg/page", extensions));
+    BOOST_CHECK(!hasExtension("", extensions));
+    BOOST_CHECK(!hasExtension("http://example.com/image.jpg", {}));
+}
+
+BOOST_AUTO_TEST_CASE(status_code) {
+    BOOST_CHECK_EQUAL(statusCode("200 OK"), 200);
+    BOOST_CHECK_EQUAL(statusCode("404"), 404);
+    BOOST_CHECK_EQUAL(statusCode("301 Moved Permanently"), 301);
+    BOOST_CHECK_EQUAL(statusCode("200OK"), 200);
+
+    BOOST_CHECK_EQUAL(statusCode(""), 0);
+    BOOST_CHECK_EQUAL(statusCode("20"), 0);
+    BOOST_CHECK_EQUAL(statusCode("2x0 OK"), 0);
+    BOOST_CHECK_EQUAL(statusCode(" 200 OK"), 0);
+    BOOST_CHECK_EQUAL(statusCode("-20 OK"), 0);
+    BOOST_CHECK_EQUAL(statusCode("OK"), 0);
+}
+
+} // namespace
+} // namespace warc2text
@@ -0,0 +1,70 @@
+#ifndef WARC2TEXT_TESTS_TEST_UTIL_HH
+#define WARC2TEXT_TESTS_TEST_UTIL_HH
+
+#include <boost/test/unit_test.hpp>
+#include <zlib.h>
+#include <zstd.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <stdlib.h>
+
+namespace warc2text {
+namespace test {
+
+// a file in /tmp holding content, removed when it goes out of scope
+class TempFile {
+    public:
+        explicit TempFile(std::string_view content = {}) {
+            char pattern[] = "/tmp/warc2text_test_XXXXXX";
+            int fd = mkstemp(pattern);
+            BOOST_REQUIRE(fd >= 0);
+            close(fd);
+            name = pattern;
+            std::ofstream(name, std::ios_base::binary).write(content.data(), content.size());
+        }
+
+        ~TempFile() {
+            std::remove(name.c_str());
+        }
+
+        TempFile(const TempFile&) = delete;
+        TempFile& operator=(const TempFile&) = delete;
+
+        std::string name;
+};
+
+// text compressed by zlib with window_bits as in deflateInit2: 16 + 15 for gzip, 15 for zlib, -15 for raw deflate
+inline std::string compress(std::string_view text, int window_bits = 16 + MAX_WBITS, int level = Z_DEFAULT_COMPRESSION) {
+    z_stream s{};
+    BOOST_REQUIRE_EQUAL(deflateInit2(&s, level, Z_DEFLATED, window_bits, 9, Z_DEFAULT_STRATEGY), Z_OK);
+    std::string out(deflateBound(&s, text.size()), '\0');
+    s.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    s.avail_in = text.size();
+    s.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    s.avail_out = out.size();
+    BOOST_REQUIRE_EQUAL(deflate(&s, Z_FINISH), Z_STREAM_END);
+    out.resize(s.total_out);
+    deflateEnd(&s);
+    return out;
+}
+
+// text compressed into a single zstd frame, with dictionary if it is not empty
+inline std::string compressZstd(std::string_view text, std::string_view dictionary = {}, int level = 3) {
+    std::string out(ZSTD_compressBound(text.size()), '\0');
+    ZSTD_CCtx* ctx = ZSTD_createCCtx();
+    BOOST_REQUIRE(ctx);
+    std::size_t len = ZSTD_compress_usingDict(ctx, &out[0], out.size(), text.data(), text.size(),
+                                              dictionary.data(), dictionary.size(), level);
+    ZSTD_freeCCtx(ctx);
+    BOOST_REQUIRE(!ZSTD_isError(len));
+    out.resize(len);
+    return out;
+}
+
+} // namespace test
+} // namespace warc2text
+
+#endif
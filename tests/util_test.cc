@@ -0,0 +1,82 @@
+#define BOOST_TEST_MODULE util
+#include <boost/test/unit_test.hpp>
+
+#include "src/util.hh"
+#include <string>
+
+namespace util {
+namespace {
+
+BOOST_AUTO_TEST_CASE(valid_utf8) {
+    BOOST_CHECK(isValidUTF8(""));
+    BOOST_CHECK(isValidUTF8("plain ASCII text that is longer than eight bytes"));
+    BOOST_CHECK(isValidUTF8("caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80"));
+    // the smallest and largest code points of each length
+    BOOST_CHECK(isValidUTF8("\xc2\x80\xdf\xbf"));
+    BOOST_CHECK(isValidUTF8("\xe0\xa0\x80\xef\xbf\xbf"));
+    BOOST_CHECK(isValidUTF8("\xf0\x90\x80\x80\xf4\x8f\xbf\xbf"));
+    // around the surrogates
+    BOOST_CHECK(isValidUTF8("\xed\x9f\xbf\xee\x80\x80"));
+    BOOST_CHECK(isValidUTF8(std::string("nul \0 is a character", 20)));
+}
+
+BOOST_AUTO_TEST_CASE(overlong_utf8) {
+    BOOST_CHECK(!isValidUTF8("\xc0\xaf"));
+    BOOST_CHECK(!isValidUTF8("\xc1\xbf"));
+    BOOST_CHECK(!isValidUTF8("\xe0\x80\xaf"));
+    BOOST_CHECK(!isValidUTF8("\xe0\x9f\xbf"));
+    BOOST_CHECK(!isValidUTF8("\xf0\x80\x80\xaf"));
+    BOOST_CHECK(!isValidUTF8("\xf0\x8f\xbf\xbf"));
+}
+
+BOOST_AUTO_TEST_CASE(surrogate_utf8) {
+    BOOST_CHECK(!isValidUTF8("\xed\xa0\x80"));
+    BOOST_CHECK(!isValidUTF8("\xed\xbf\xbf"));
+    // a pair encoded the way CESU-8 does it
+    BOOST_CHECK(!isValidUTF8("\xed\xa0\xbd\xed\xb8\x80"));
+}
+
+BOOST_AUTO_TEST_CASE(broken_utf8) {
+    // past U+10FFFF
+    BOOST_CHECK(!isValidUTF8("\xf4\x90\x80\x80"));
+    BOOST_CHECK(!isValidUTF8("\xf5\x80\x80\x80"));
+    BOOST_CHECK(!isValidUTF8("\xff"));
+    // continuation bytes on their own, and sequences cut short at the end or in the middle
+    BOOST_CHECK(!isValidUTF8("\x80"));
+    BOOST_CHECK(!isValidUTF8("abcdefgh\xbf"));
+    BOOST_CHECK(!isValidUTF8("caf\xc3"));
+    BOOST_CHECK(!isValidUTF8("\xe2\x82"));
+    BOOST_CHECK(!isValidUTF8("\xe2\x82 euro"));
+    BOOST_CHECK(!isValidUTF8("\xf0\x9f\x98"));
+}
+
+BOOST_AUTO_TEST_CASE(to_utf8) {
+    std::string out;
+    BOOST_CHECK(toUTF8("caf\xe9", "ISO-8859-1", out));
+    BOOST_CHECK_EQUAL(out, "caf\xc3\xa9");
+    BOOST_CHECK(toUTF8("\x80 5", "windows-1252", out));
+    BOOST_CHECK_EQUAL(out, "\xe2\x82\xac 5");
+    BOOST_CHECK(toUTF8("", "ISO-8859-1", out));
+    BOOST_CHECK_EQUAL(out, "");
+    // output that grows past the first guess
+    std::string latin(10000, '\xe9');
+    BOOST_CHECK(toUTF8(latin, "ISO-8859-1", out));
+    BOOST_CHECK_EQUAL(out.size(), 20000);
+    BOOST_CHECK(isValidUTF8(out));
+    // shift state written out at the end
+    BOOST_CHECK(toUTF8("\x1b$B$3$s\x1b(B", "ISO-2022-JP", out));
+    BOOST_CHECK_EQUAL(out, "\xe3\x81\x93\xe3\x82\x93");
+}
+
+BOOST_AUTO_TEST_CASE(to_utf8_errors) {
+    std::string out;
+    BOOST_CHECK(!toUTF8("text", "no-such-charset", out));
+    // not valid in the charset it is said to be in
+    BOOST_CHECK(!toUTF8("caf\xc3", "UTF-8", out));
+    BOOST_CHECK(!toUTF8("\xc0\xaf", "UTF-8", out));
+    BOOST_CHECK(!toUTF8("\xed\xa0\x80", "UTF-8", out));
+    BOOST_CHECK(!toUTF8("\x82\xa0\x82", "Shift_JIS", out));
+}
+
+} // namespace
+} // namespace util
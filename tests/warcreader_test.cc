@@ -0,0 +1,294 @@
+#define BOOST_TEST_MODULE warcreader
+#include <boost/test/unit_test.hpp>
+
+#include "src/cdx.hh"
+#include "src/parallelreader.hh"
+#include "src/warcreader.hh"
+#include "test_util.hh"
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace warc2text {
+namespace {
+
+// noise adds that many bytes to the block that do not compress
+std::string warcRecord(int i, const std::string& eol = "\r\n", std::size_t noise = 0) {
+    std::string type = i % 3 == 2 ? "request" : "response";
+    std::string block = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n<p>record " + std::to_string(i) + "</p>"
+        + std::string(i * 37 % 500, 'x');
+    for (unsigned state = i + 1; block.size() < noise; state = state * 1103515245 + 12345)
+        block.push_back('a' + (state >> 16) % 26);
+    return "WARC/1.0" + eol + "WARC-Type: " + type + eol + "WARC-Target-URI: http://example.com/" + std::to_string(i) + eol
+        + "Content-Type: application/http; msgtype=" + type + eol + "Content-Length: " + std::to_string(block.size()) + eol
+        + eol + block + "\r\n\r\n";
+}
+
+enum class WARCFormat { plain, gzip, zstd, zstd_dict };
+
+// text a zstd dictionary is made of, which records compressed with it share
+const std::string kDictionary = warcRecord(0) + warcRecord(2);
+
+// WARC file of records, compressed per record or not. The record in the middle gets noise bytes.
+// zstd_dict files start with the dictionary in a skippable frame, compressed if compress_dictionary.
+struct WARCFile {
+    std::vector<std::string> records;
+    std::vector<std::size_t> offsets; // of each record, and of the end of the file
+    test::TempFile file;
+    const std::string& name;
+
+    WARCFile(WARCFormat format, int count, const std::string& eol = "\r\n", std::size_t noise = 0, bool compress_dictionary = false) :
+        file(content(format, count, eol, noise, compress_dictionary)),
+        name(file.name) {}
+
+    std::string content(WARCFormat format, int count, const std::string& eol, std::size_t noise, bool compress_dictionary) {
+        std::string content;
+        if (format == WARCFormat::zstd_dict) {
+            std::string dictionary = compress_dictionary ? test::compressZstd(kDictionary) : kDictionary;
+            content = frame(0x184D2A5D) + frame(dictionary.size()) + dictionary;
+        }
+        for (int i = 0; i < count; ++i) {
+            records.push_back(warcRecord(i, eol, i == count / 2 ? noise : 0));
+            offsets.push_back(content.size());
+            switch (format) {
+                case WARCFormat::plain: content.append(records.back()); break;
+                case WARCFormat::gzip: content.append(test::compress(records.back())); break;
+                case WARCFormat::zstd: content.append(test::compressZstd(records.back())); break;
+                case WARCFormat::zstd_dict: content.append(test::compressZstd(records.back(), kDictionary)); break;
+            }
+        }
+        offsets.push_back(content.size());
+        return content;
+    }
+
+    // little endian 32 bit field of a zstd skippable frame header
+    static std::string frame(uint32_t value) {
+        std::string bytes;
+        for (int i = 0; i < 4; ++i)
+            bytes.push_back(static_cast<char>(value >> (8 * i) & 0xff));
+        return bytes;
+    }
+};
+
+// records read by reader with the offsets they were at, empty records included
+std::vector<std::pair<std::size_t, std::string>> readAll(RecordReader& reader) {
+    std::vector<std::pair<std::size_t, std::string>> read;
+    std::string out;
+    std::size_t offset;
+    while (reader.nextRecord(out, offset) > 0)
+        read.emplace_back(offset, out);
+    return read;
+}
+
+BOOST_AUTO_TEST_CASE(read_records) {
+    for (WARCFormat format : {WARCFormat::gzip, WARCFormat::plain}) {
+        WARCFile warc(format, 20);
+        WARCReader reader(warc.name);
+        auto read = readAll(reader);
+        BOOST_REQUIRE_EQUAL(read.size(), warc.records.size());
+        for (std::size_t i = 0; i < read.size(); ++i) {
+            BOOST_CHECK_EQUAL(read[i].first, warc.offsets[i]);
+            // plain records keep the empty lines that close them
+            BOOST_CHECK(read[i].second == warc.records[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(header_filter) {
+    for (WARCFormat format : {WARCFormat::gzip, WARCFormat::plain}) {
+        for (std::string eol : {"\r\n", "\n"}) {
+            WARCFile warc(format, 12, eol);
+            WARCReader reader(warc.name, 64);
+            std::vector<std::string> headers;
+            reader.setHeaderFilter([&headers](std::string_view header) {
+                headers.emplace_back(header);
+                return header.find("WARC-Type: request") == std::string_view::npos;
+            });
+            auto read = readAll(reader);
+            BOOST_REQUIRE_EQUAL(read.size(), warc.records.size());
+            BOOST_REQUIRE_EQUAL(headers.size(), warc.records.size());
+            for (std::size_t i = 0; i < read.size(); ++i) {
+                // the filter sees the header up to and including the empty line
+                BOOST_CHECK(headers[i] == warc.records[i].substr(0, warc.records[i].find(eol + eol) + 2 * eol.size()));
+                BOOST_CHECK_EQUAL(read[i].first, warc.offsets[i]);
+                // turned down records are read past and come back empty
+                BOOST_CHECK_EQUAL(read[i].second.empty(), i % 3 == 2);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(adjacent_ranges) {
+    // any split of the file into ranges reads every record once, from the range it starts in
+    for (WARCFormat format : {WARCFormat::gzip, WARCFormat::plain}) {
+        WARCFile warc(format, 15);
+        std::size_t size = warc.offsets.back();
+        for (std::size_t split = 0; split <= size; split += 97) {
+            for (bool use_mmap : {false, true}) {
+                std::vector<std::size_t> offsets;
+                for (auto range : {std::make_pair<std::size_t>(0, split), std::make_pair(split, size + 1)}) {
+                    WARCReader reader(warc.name, 256, use_mmap);
+                    reader.setRange(range.first, range.second);
+                    for (const auto& record : readAll(reader)) {
+                        BOOST_CHECK_GE(record.first, range.first);
+                        BOOST_CHECK_LT(record.first, range.second);
+                        offsets.push_back(record.first);
+                    }
+                }
+                std::vector<std::size_t> expected(warc.offsets.begin(), warc.offsets.end() - 1);
+                BOOST_CHECK(offsets == expected);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(zstd_records) {
+    // without a dictionary, and with one that is stored as it is or compressed itself
+    for (auto variant : {std::make_pair(WARCFormat::zstd, false), std::make_pair(WARCFormat::zstd_dict, false),
+                         std::make_pair(WARCFormat::zstd_dict, true)}) {
+        // a frame larger than the 128KB block the reader needs at once
+        WARCFile warc(variant.first, 20, "\r\n", 200000, variant.second);
+        for (std::size_t read_size : {64, 4096}) {
+            for (bool use_mmap : {false, true}) {
+                WARCReader reader(warc.name, read_size, use_mmap);
+                auto read = readAll(reader);
+                BOOST_REQUIRE_EQUAL(read.size(), warc.records.size());
+                for (std::size_t i = 0; i < read.size(); ++i) {
+                    BOOST_CHECK_EQUAL(read[i].first, warc.offsets[i]);
+                    BOOST_CHECK(read[i].second == warc.records[i]);
+                }
+            }
+        }
+        // records are found again from their offset, past the dictionary at the start
+        WARCReader reader(warc.name);
+        std::string out;
+        for (std::size_t i : {7, 10, 3}) {
+            BOOST_CHECK_EQUAL(reader.getRecordAt(warc.offsets[i], warc.offsets[i + 1] - warc.offsets[i], out), warc.offsets[i + 1] - warc.offsets[i]);
+            BOOST_CHECK(out == warc.records[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(recover) {
+    // a record whose start is broken, and garbage between two records, in the middle of the file
+    const std::string garbage = std::string(90, '#') + "\r\n\r\n";
+    for (WARCFormat format : {WARCFormat::gzip, WARCFormat::zstd, WARCFormat::plain}) {
+        WARCFile warc(format, 12);
+        std::ifstream in(warc.name, std::ios_base::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        content.replace(warc.offsets[4], 4, "XXXX");
+        content.insert(warc.offsets[8], garbage);
+        test::TempFile broken(content);
+
+        // each corrupt range comes back as an empty record, everything else as it was
+        std::vector<std::pair<std::size_t, std::string>> expected;
+        for (std::size_t i = 0; i < warc.records.size(); ++i) {
+            if (i == 8)
+                expected.emplace_back(warc.offsets[8], "");
+            expected.emplace_back(warc.offsets[i] + (i >= 8 ? garbage.size() : 0), i == 4 ? "" : warc.records[i]);
+        }
+
+        std::vector<std::unique_ptr<RecordReader>> readers;
+        for (bool use_mmap : {false, true}) {
+            readers.push_back(std::make_unique<WARCReader>(broken.name, 256, use_mmap));
+            readers.back()->setRecover(true);
+        }
+        auto inner = std::make_unique<WARCReader>(broken.name);
+        inner->setRecover(true);
+        readers.push_back(std::make_unique<ReadAheadWARCReader>(std::move(inner), 4));
+        if (format == WARCFormat::gzip) {
+            for (unsigned threads : {1, 3}) {
+                readers.push_back(std::make_unique<ParallelWARCReader>(broken.name, threads, 1024*1024*20, 512));
+                readers.back()->setRecover(true);
+            }
+        }
+
+        for (auto& reader : readers) {
+            auto read = readAll(*reader);
+            BOOST_REQUIRE_EQUAL(read.size(), expected.size());
+            for (std::size_t i = 0; i < read.size(); ++i) {
+                BOOST_CHECK_EQUAL(read[i].first, expected[i].first);
+                BOOST_CHECK(read[i].second == expected[i].second);
+            }
+            SkipStatistics skipped = reader->getSkipStatistics();
+            BOOST_CHECK_EQUAL(skipped.ranges, 2);
+            BOOST_CHECK_EQUAL(skipped.bytes, warc.offsets[5] - warc.offsets[4] + garbage.size());
+        }
+
+        // without recover the first corrupt record ends the file with an exception
+        WARCReader reader(broken.name);
+        std::string out;
+        for (int i = 0; i < 4; ++i)
+            BOOST_CHECK_GT(reader.getRecord(out), 0);
+        BOOST_CHECK_THROW(reader.getRecord(out), WARCFileException);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(indexed_reader) {
+    for (WARCFormat format : {WARCFormat::gzip, WARCFormat::zstd_dict, WARCFormat::plain}) {
+        WARCFile warc(format, 12);
+        auto length = [&warc](std::size_t i) { return std::to_string(warc.offsets[i + 1] - warc.offsets[i]); };
+        // the entry of record 5 is a few bytes off, with its length known or not
+        for (std::string bad_length : {length(5), std::string("-")}) {
+            test::TempFile cdx(
+                " CDX g V S a\n"
+                + warc.name + " " + std::to_string(warc.offsets[2]) + " " + length(2) + " http://example.com/2\n"
+                + warc.name + " " + std::to_string(warc.offsets[5] + 3) + " " + bad_length + " http://example.com/5\n"
+                + warc.name + " " + std::to_string(warc.offsets[0]) + " " + length(0) + " http://example.com/0\n"
+                + warc.name + " " + std::to_string(warc.offsets[7]) + " " + length(7) + " http://example.com/7\n"
+                + warc.name + " " + std::to_string(warc.offsets[11]) + " - http://example.com/11\n");
+            WARCIndex index;
+            readCDX(cdx.name, "", index);
+            BOOST_REQUIRE_EQUAL(index.size(), 1);
+            const std::vector<IndexEntry>& entries = index.at(warc.name);
+            BOOST_REQUIRE_EQUAL(entries.size(), 5);
+
+            IndexedWARCReader reader(std::make_unique<WARCReader>(warc.name), warc.name, entries);
+            std::string out;
+            std::size_t offset;
+            // in the order of the index, which is sorted by offset
+            for (std::size_t i : {0, 2}) {
+                BOOST_CHECK_EQUAL(reader.nextRecord(out, offset), warc.offsets[i + 1] - warc.offsets[i]);
+                BOOST_CHECK_EQUAL(offset, warc.offsets[i]);
+                BOOST_CHECK(out == warc.records[i]);
+            }
+            // the bad entry comes back empty, and is not the end of the index
+            BOOST_CHECK_EQUAL(reader.nextRecord(out, offset), std::max<std::size_t>(entries[2].length, 1));
+            BOOST_CHECK_EQUAL(offset, warc.offsets[5] + 3);
+            BOOST_CHECK(out.empty());
+            for (std::size_t i : {7, 11}) {
+                BOOST_CHECK_EQUAL(reader.nextRecord(out, offset), warc.offsets[i + 1] - warc.offsets[i]);
+                BOOST_CHECK_EQUAL(offset, warc.offsets[i]);
+                BOOST_CHECK(out == warc.records[i]);
+            }
+            BOOST_CHECK_EQUAL(reader.nextRecord(out, offset), 0);
+            BOOST_CHECK_EQUAL(entries[2].length, bad_length == "-" ? 0 : warc.offsets[6] - warc.offsets[5]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_reader) {
+    // windows far smaller than the file, and than the member in the middle
+    WARCFile warc(WARCFormat::gzip, 40, "\r\n", 20000);
+    BOOST_REQUIRE_GT(warc.offsets[21] - warc.offsets[20], 4 * 1024);
+    WARCReader reader(warc.name);
+    auto expected = readAll(reader);
+    BOOST_REQUIRE_EQUAL(expected.size(), warc.records.size());
+    for (unsigned threads : {1, 3, 4}) {
+        for (std::size_t window_size : {512, 1024, 4096}) {
+            ParallelWARCReader parallel(warc.name, threads, 1024*1024*20, window_size);
+            auto read = readAll(parallel);
+            BOOST_REQUIRE_EQUAL(read.size(), expected.size());
+            for (std::size_t i = 0; i < read.size(); ++i) {
+                BOOST_CHECK_EQUAL(read[i].first, expected[i].first);
+                BOOST_CHECK(read[i].second == expected[i].second);
+            }
+        }
+    }
+}
+
+} // namespace
+} // namespace warc2text
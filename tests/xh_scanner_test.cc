@@ -0,0 +1,172 @@
+#define BOOST_TEST_MODULE xh_scanner
+#include <boost/test/unit_test.hpp>
+
+#include "src/record.hh"
+#include "src/warcreader.hh"
+#include "src/xh_scanner.hh"
+#include "legacy_xh_scanner.hh"
+#include <string>
+#include <vector>
+
+// Checks markup::scanner against the scanner it replaced, which read its input one character at
+// a time, on the documents in data/html.warc.gz and on the cases where they are known to differ.
+// It is built once for each of the ways the scanner looks at blocks of input.
+
+namespace warc2text {
+namespace {
+
+#if defined(__AVX2__)
+const char* blocks = "AVX2";
+#elif defined(__SSE2__)
+const char* blocks = "SSE2";
+#else
+const char* blocks = "none";
+#endif
+
+using token = markup::scanner::token_type;
+
+// The tokens of a document as text. The old scanner handed out the content of a comment, CDATA
+// section, script or style element MAX_TOKEN_SIZE - 1 characters at a time and the new one in a
+// single TT_DATA, so runs of TT_DATA are joined into one. The old one also handed out the
+// content of an element that never ends, the new one goes straight to TT_EOF, so a TT_DATA
+// right before the end is left out.
+template <typename Scanner>
+std::vector<std::string> tokens(Scanner& scanner) {
+    std::vector<std::string> out;
+    bool data = false;
+    while (true) {
+        int type = scanner.get_token();
+        if (type == markup::scanner::TT_DATA) {
+            if (data)
+                out.back().append(scanner.get_value());
+            else
+                out.push_back("data " + std::string(scanner.get_value()));
+            data = true;
+            continue;
+        }
+        if (type == markup::scanner::TT_EOF && data)
+            out.pop_back();
+        data = false;
+        std::string text = std::to_string(type);
+        if (type == markup::scanner::TT_TAG_START || type == markup::scanner::TT_TAG_END)
+            text.append(" ").append(scanner.get_tag_name());
+        else if (type == markup::scanner::TT_ATTR)
+            text.append(" ").append(scanner.get_attr_name()).append("=").append(scanner.get_value());
+        else if (type == markup::scanner::TT_WORD || type == markup::scanner::TT_SPACE)
+            text.append(" ").append(scanner.get_value());
+        out.push_back(text);
+        if (type == markup::scanner::TT_EOF || type == markup::scanner::TT_ERROR)
+            return out;
+    }
+}
+
+std::vector<std::string> legacyTokens(const std::string& html) {
+    legacy_markup::instream input(html.data(), html.data() + html.size());
+    legacy_markup::scanner scanner(input);
+    return tokens(scanner);
+}
+
+std::vector<std::string> newTokens(const std::string& html) {
+    markup::scanner scanner(html.data(), html.data() + html.size());
+    return tokens(scanner);
+}
+
+// the raw tokens of the new scanner, with values
+std::vector<std::pair<token, std::string>> rawTokens(const std::string& html) {
+    markup::scanner scanner(html.data(), html.data() + html.size());
+    std::vector<std::pair<token, std::string>> out;
+    token type;
+    do {
+        type = scanner.get_token();
+        out.emplace_back(type, scanner.get_value());
+    } while (type != markup::scanner::TT_EOF && type != markup::scanner::TT_ERROR);
+    return out;
+}
+
+std::size_t count(const std::vector<std::pair<token, std::string>>& tokens, token type) {
+    std::size_t n = 0;
+    for (const auto& t : tokens)
+        n += t.first == type;
+    return n;
+}
+
+BOOST_AUTO_TEST_CASE(same_tokens_on_warc) {
+    BOOST_TEST_MESSAGE("scanner blocks: " << blocks);
+    const std::string filename = "data/html.warc.gz";
+    WARCReader reader(filename);
+    std::string content;
+    std::size_t documents = 0;
+    while (reader.getRecord(content) > 0) {
+        Record record(content, filename, content.size(), 0);
+        std::string html(record.getPayload());
+        BOOST_CHECK_MESSAGE(legacyTokens(html) == newTokens(html), "tokens differ for " << record.getURL());
+        ++documents;
+    }
+    BOOST_CHECK_EQUAL(documents, 159);
+}
+
+BOOST_AUTO_TEST_CASE(unquoted_attribute_value) {
+    // the first character of a value without quotes is left out, as it always was
+    std::string html = "<td align=center width = 10 nowrap><a href=http://example.com/>";
+    BOOST_CHECK(legacyTokens(html) == newTokens(html));
+    std::vector<std::string> expected = {"1 td", "3 align=enter", "3 width=0", "3 nowrap=", "1 a", "3 href=ttp://example.com/", "0"};
+    BOOST_CHECK(newTokens(html) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(comment_tail_on_read_boundary) {
+    // "-->" is not seen where the old 1023 character reads split it
+    for (std::size_t n = 1000; n < 1060; ++n) {
+        for (std::string tag : {"!--", "![CDATA["}) {
+            std::string html = "<" + tag + std::string(n, 'c') + (tag == "!--" ? "-->" : "]]>") + "after";
+            BOOST_CHECK(legacyTokens(html) == newTokens(html));
+            auto tokens = rawTokens(html);
+            bool missed = n == 1021 || n == 1022;
+            BOOST_CHECK_EQUAL(count(tokens, markup::scanner::TT_WORD), missed ? 0 : 1);
+            BOOST_CHECK_EQUAL(count(tokens, markup::scanner::TT_DATA), missed ? 0 : 1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(end_tag_on_read_boundary) {
+    // a '<' too close to the end of a read starts the next one, so end tags are always found
+    for (std::size_t n = 1000; n < 1060; ++n) {
+        for (std::string fill : {"s", "<", "a<b>"}) {
+            std::string body;
+            while (body.size() < n)
+                body.append(fill);
+            body.resize(n);
+            std::string html = "<script>" + body + "</script>after<style>" + body + "</style>";
+            BOOST_CHECK(legacyTokens(html) == newTokens(html));
+            auto tokens = rawTokens(html);
+            BOOST_REQUIRE_EQUAL(count(tokens, markup::scanner::TT_DATA), 2);
+            BOOST_CHECK_EQUAL(count(tokens, markup::scanner::TT_WORD), 1);
+            BOOST_CHECK_EQUAL(tokens[1].second, body);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(empty_tag_name) {
+    // "<>" after a script used to compare the end tag against what was left of "script"
+    std::string html = "<script>x</script><>text</><style></style><>";
+    BOOST_CHECK(legacyTokens(html) == newTokens(html));
+    std::vector<std::string> expected = {"1 script", "data x", "2 script", "1 ", "4 text", "2 ", "1 style", "data ", "2 style", "1 ", "0"};
+    BOOST_CHECK(newTokens(html) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(single_data_token) {
+    // the old scanner handed these out 1023 characters at a time
+    std::string body(5000, 'x');
+    for (std::string html : {"<!--" + body + "-->", "<![CDATA[" + body + "]]>", "<script>" + body + "</script>", "<style>" + body + "</style>"}) {
+        auto tokens = rawTokens(html);
+        BOOST_REQUIRE_EQUAL(tokens.size(), 4);
+        BOOST_CHECK_EQUAL(tokens[1].first, markup::scanner::TT_DATA);
+        BOOST_CHECK_EQUAL(tokens[1].second, body);
+        BOOST_CHECK(legacyTokens(html) == newTokens(html));
+    }
+    // and an element that does not end has no content at all
+    auto tokens = rawTokens("<!--" + body);
+    BOOST_CHECK_EQUAL(count(tokens, markup::scanner::TT_DATA), 0);
+}
+
+} // namespace
+} // namespace warc2text
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <chrono>
 #include <vector>
+#include <thread>
+#include <algorithm>
+#include <limits>
 #include <unordered_set>
 #include <boost/log/trivial.hpp>
 #include <boost/program_options.hpp>
@@ -29,6 +32,7 @@ struct Options : WARCPreprocessorOptions {
     std::string compress;
     int compress_level;
     std::string encoding_errors;
+    std::string inflate_engine_name;
     unsigned buffer_size;
 };
 
@@ -44,11 +48,14 @@ void parseArgs(int argc, char *argv[], Options& out) {
         ("tag-filters", po::value(&out.tag_filters_filename), "Plain text file containing tag filters")
         ("invert-tag-filters", po::bool_switch(&out.tag_filters_invert)->default_value(false), "Invert tag filter application")
         ("url-filters", po::value(&out.url_filters_filename), "Plain text file containing url filters")
+        ("start-date", po::value(&out.start_date), "Only process the records with a WARC-Date at or after this ISO 8601 date")
+        ("end-date", po::value(&out.end_date), "Only process the records with a WARC-Date before this ISO 8601 date")
         ("pdfpass", po::value(&out.pdf_warc_filename), "Write PDF records to WARC")
         ("robotspass", po::value(&out.robots_warc_filename), "Write robots.txt records to WARC")
         ("robots-process", po::bool_switch(&out.robots_process), "Process robots.txt as normal documents")
         ("paragraph-identification", po::bool_switch(&out.paragraph_identification)->default_value(false), "Add paragraph index in each b64encoded document as tab separated column")
         ("skip-text-extraction", po::bool_switch(&out.skip_text_extraction)->default_value(false))
+        ("wet", po::bool_switch(&out.wet)->default_value(false), "Also process conversion records, taking their text as is")
         ("verbose,v", po::bool_switch(&out.verbose)->default_value(false), "Verbosity level")
         ("silent,s", po::bool_switch(&out.silent)->default_value(false))
         ("multilang", po::bool_switch(&out.multilang)->default_value(false), "Detect multiple languages in a single record")
@@ -62,6 +69,25 @@ void parseArgs(int argc, char *argv[], Options& out) {
         ("buffer-size", po::value(&out.buffer_size)->default_value(32*1024), "Buffer size for write operations in KB (default 32)")
         ("strict-exit", po::bool_switch(&out.strict_exit)->default_value(false), "Be strict with exit codes.")
         ("max-record-size", po::value(&out.max_record_size)->default_value(20), "Maximum size in MB for a record to be skipped")
+        ("threads,j", po::value(&out.threads)->default_value(1), "Number of threads used to process records")
+        ("parallel-files", po::value(&out.parallel_files)->default_value(1), "Number of input files read concurrently")
+        ("inflate-threads", po::value(&out.inflate_threads)->default_value(0), "Number of threads inflating the records of each input")
+        ("inflate-ahead", po::value(&out.inflate_ahead)->default_value(0), "Number of records inflated ahead on a background thread")
+        ("read-size", po::value(&out.read_size)->default_value(1), "Size in MB of each read from the input files")
+        ("mmap", po::bool_switch(&out.mmap_input)->default_value(false), "Map input files into memory instead of reading them")
+        ("read-ahead", po::value(&out.read_ahead)->default_value(0), "Number of reads from the input files kept in flight")
+        ("inflate-engine", po::value(&out.inflate_engine_name)->default_value("zlib"), "Library used to inflate the input records")
+        ("reuse-records", po::bool_switch(&out.reuse_records)->default_value(false), "Reuse the memory of records that were written for the next ones")
+        ("recover", po::bool_switch(&out.recover)->default_value(false), "Skip corrupt records and carry on with the next one")
+        ("start-offset", po::value(&out.start_offset), "Only read the records starting at or after this byte offset")
+        ("end-offset", po::value(&out.end_offset), "Only read the records starting before this byte offset")
+        ("cdx", po::value(&out.cdx_filename), "CDX(J) index of the only records to process")
+        ("cdx-prefix", po::value(&out.cdx_prefix), "Path to put in front of the WARC file names in the CDX index")
+        ("cdxj", po::value(&out.cdxj_filename), "Write a CDXJ index of all the records read")
+        ("sort-cdxj", po::bool_switch(&out.cdxj_sorted)->default_value(false), "Sort the CDXJ index by SURT")
+        ("checkpoint", po::value(&out.checkpoint_filename), "Ledger of how far the run got, to carry on from if it exists")
+        ("checkpoint-interval", po::value(&out.checkpoint_interval)->default_value(60), "Seconds between checkpoints")
+        ("deadline", po::value(&out.deadline)->default_value(0), "Seconds after which to stop at a checkpoint")
         ;
 
     po::positional_options_description pd;
@@ -86,6 +112,9 @@ void parseArgs(int argc, char *argv[], Options& out) {
                 " --invert-tag-filters             Only output records that got filtered\n"
                 " --url-filters <filters_file>     File containing url filters\n"
                 "                                  Format: \"regexp\"\n"
+                " --start-date <date>              Only process the records with a WARC-Date at or after\n"
+                "                                  <date>, e.g. 2024-01-15 or 2024-01-15T12:00:00Z\n"
+                " --end-date <date>                Only process the records with a WARC-Date before <date>\n"
                 " --pdfpass <output_warc>          Write PDF records to <output_warc>\n"
                 " --robotspass <output_warc>       Write Robots.txt records to <output_warc>\n"
                 " --robots-process                 Process Robots.txt as any other document, instead of throwing them out\n"
@@ -94,6 +123,9 @@ void parseArgs(int argc, char *argv[], Options& out) {
                 " --skip-text-extraction           Skip text extraction and output only html\n"
                 "                                  This option is not compatible with \"text\" value in -f option \n"
                 "                                  and also requires to skip language identification\n"
+                " --wet                            Also process conversion records (WET files), taking their\n"
+                "                                  text/plain payload as the text of the document, without\n"
+                "                                  charset detection or HTML extraction\n"
                 " --jsonl                          Produce \"html\" and \"text\" files in JSONLines format,\n"
                 "                                  instead of bease64 encoded lines\n"
                 " --stdout                         Write all the information in JSONLines to stdout\n"
@@ -107,6 +139,41 @@ void parseArgs(int argc, char *argv[], Options& out) {
                 " --buffer-size <size>             Buffer size for write operations in KB (default 32)\n"
                 " --strict-exit                    Strict exit codes. Return non-zero if a WARC read error occurred\n"
                 " --max-record-size <size>         Maximum size in MB for a record to be skipped\n"
+                " -j, --threads <n>                Number of threads used to process records (default 1, 0 uses all cores)\n"
+                "                                  Output order is the same as with a single thread\n"
+                " --parallel-files <n>             Number of input WARCs read concurrently (default 1)\n"
+                "                                  Largest files are started first\n"
+                " --inflate-threads <n>            Inflate the gzip members of each input on <n> threads\n"
+                "                                  ahead of processing (default 0, inflate while reading)\n"
+                " --inflate-ahead <n>              Inflate up to <n> records ahead on a background thread\n"
+                "                                  (default 0, inflate while reading)\n"
+                " --read-size <size>               Size in MB of each read from the input files (default 1)\n"
+                " --mmap                           Map regular input files into memory instead of reading them\n"
+                " --read-ahead <n>                 Keep up to <n> reads of --read-size from the input files\n"
+                "                                  in flight on background threads (default 0, read on demand)\n"
+                " --inflate-engine <engine>        Library used to inflate the input records\n"
+                "                                  Default: zlib. Values: zlib or libdeflate (if built with it)\n"
+                " --reuse-records                  Reset and reuse the records that were written instead of\n"
+                "                                  allocating new ones. Keeps the memory the largest records\n"
+                "                                  needed for as long as the run lasts\n"
+                " --recover                        Skip corrupt records up to the next record that can be read,\n"
+                "                                  instead of the rest of the WARC\n"
+                " --start-offset <offset>          Only read the records of each input starting at or after\n"
+                "                                  byte <offset>, reading starts at the first record after it\n"
+                " --end-offset <offset>            Only read the records of each input starting before byte <offset>\n"
+                "                                  Several runs with adjacent ranges split a WARC with no overlap\n"
+                " --cdx <index>                    Only process the records listed in a CDX or CDXJ index\n"
+                "                                  (\"-\" for stdin) instead of whole input WARCs\n"
+                " --cdx-prefix <path>              Put <path> in front of the WARC file names in the index\n"
+                " --cdxj <file>                    Write a CDXJ index of all the records read to <file>,\n"
+                "                                  including their charset and detected languages\n"
+                " --sort-cdxj                      Sort the CDXJ index by SURT at the end of the run,\n"
+                "                                  instead of writing records in the order they are read\n"
+                " --checkpoint <file>              Save how far the run got to <file> every --checkpoint-interval\n"
+                "                                  and at the end. If <file> exists, carry on from where it says\n"
+                " --checkpoint-interval <seconds>  Seconds between checkpoints (default 60)\n"
+                " --deadline <seconds>             Stop reading <seconds> after the start and end with a checkpoint\n"
+                "                                  (default 0, no deadline). Exits with 3 if input was left\n"
                 " -s                               Only output errors\n"
                 " -v                               Verbose output (print trace)\n\n";
         exit(1);
@@ -120,6 +187,9 @@ int main(int argc, char *argv[]) {
     Options options;
     parseArgs(argc,argv, options);
     options.max_record_size = 1024*1024*options.max_record_size; // max record size is in MB
+    options.read_size = 1024*1024*options.read_size; // read size is in MB
+    if (options.threads == 0)
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
 
     // configure logging
     boost::log::add_console_log(std::cerr, boost::log::keywords::format = "[%TimeStamp%] [\%Severity%] %Message%");
@@ -138,6 +208,32 @@ int main(int argc, char *argv[]) {
         BOOST_LOG_TRIVIAL(error) << "'--robotspass' and '--robots-process' are mutually exclusive.";
         abort();
     }
+    if (!options.cdx_filename.empty() && !options.warcs.empty()) {
+        BOOST_LOG_TRIVIAL(error) << "Input WARCs cannot be combined with '--cdx', the WARCs are the ones in the index.";
+        abort();
+    }
+    if (!options.cdx_filename.empty() && (options.start_offset > 0 || options.end_offset < std::numeric_limits<size_t>::max())) {
+        BOOST_LOG_TRIVIAL(error) << "'--start-offset' and '--end-offset' cannot be combined with '--cdx'.";
+        abort();
+    }
+    if (!options.checkpoint_filename.empty()) {
+        if (options.stdout || !options.cdx_filename.empty() || options.cdxj_sorted || options.warcs.empty()
+                || std::find(options.warcs.begin(), options.warcs.end(), "-") != options.warcs.end()) {
+            BOOST_LOG_TRIVIAL(error) << "'--checkpoint' needs input WARC files and output files, it cannot be combined with '--stdout', '--cdx' or '--sort-cdxj'.";
+            abort();
+        }
+    } else if (options.deadline > 0) {
+        BOOST_LOG_TRIVIAL(error) << "'--deadline' needs '--checkpoint' to carry on later.";
+        abort();
+    }
+    if (options.start_offset > options.end_offset) {
+        BOOST_LOG_TRIVIAL(error) << "'--start-offset' cannot be after '--end-offset'.";
+        abort();
+    }
+    if (!options.end_date.empty() && options.start_date > options.end_date) {
+        BOOST_LOG_TRIVIAL(error) << "'--start-date' cannot be after '--end-date'.";
+        abort();
+    }
     if (options.skip_text_extraction) {
         if (options.files.find("text") != std::string::npos) {
             BOOST_LOG_TRIVIAL(error) << "Cannot use 'text' as output file with '--skip-text-extraction'. Please use '-f url,html' or any other combination that does not include it.";
@@ -161,6 +257,11 @@ int main(int argc, char *argv[]) {
         abort();
     }
 
+    if (!parseInflateEngine(options.inflate_engine_name, options.inflate_engine)) {
+        BOOST_LOG_TRIVIAL(error) << "Invalid or unavailable inflate engine '" << options.inflate_engine_name << "'";
+        abort();
+    }
+
     json_error encoding_errors;
     if (options.encoding_errors == "ignore") {
         encoding_errors = json_error::ignore;
@@ -215,18 +316,15 @@ int main(int argc, char *argv[]) {
 
     std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     bool warc_file_error = false;
+    bool stopped_early = false;
     try {
         WARCPreprocessor warcpproc(*writer, *detector, options);
-        if(options.warcs.empty())
+        if (!options.cdx_filename.empty())
+            options.warcs = warcpproc.getIndexedFiles();
+        else if(options.warcs.empty())
             options.warcs.push_back(""); // read from an empty filename, which will default to stdin
-        for (const std::string& file : options.warcs){
-            try {
-                warcpproc.process(file);
-            } catch (const WARCFileException &e) {
-                warc_file_error = true;
-                continue;
-            }
-        }
+        warc_file_error = !warcpproc.process(options.warcs);
+        stopped_early = warcpproc.stoppedEarly();
         warcpproc.printStatistics();
 
     } catch (const std::exception &e) {
@@ -244,6 +342,8 @@ int main(int argc, char *argv[]) {
         BOOST_LOG_TRIVIAL(error) << "There were WARC files that failed to open";
     if (warc_file_error && options.strict_exit)
         return 2;
+    if (stopped_early)
+        return 3;
 
     return 0;
 }